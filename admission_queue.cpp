@@ -0,0 +1,67 @@
+#include "admission_queue.h"
+#include <algorithm>
+#include <chrono>
+
+void AdmissionQueue::configure(int s, int depth) {
+    slots = std::max(s, 1);
+    order_depth = std::max(depth, 0);
+}
+
+bool AdmissionQueue::queuedAhead(Lane lane) const {
+    // Newcomers go behind their own lane, and orders behind any cancel
+    return !queue[lane].empty() || (lane == ORDER && !queue[CANCEL].empty());
+}
+
+bool AdmissionQueue::enter(Lane lane) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (active < slots && !queuedAhead(lane)) {
+        stats.active.set(++active);
+        return true;
+    }
+    if (lane == ORDER && static_cast<int>(queue[ORDER].size()) >= order_depth) {
+        stats.shed.add();
+        return false;
+    }
+
+    Waiter self;
+    queue[lane].push_back(&self);
+    stats.queued[lane].set(static_cast<int64_t>(queue[lane].size()));
+    auto start = std::chrono::steady_clock::now();
+    self.ready.wait(lock, [&self] { return self.granted; });
+    stats.wait_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+bool AdmissionQueue::tryEnter(Lane lane) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (lane == ORDER && (active >= slots || queuedAhead(lane))) {
+        stats.shed.add();
+        return false;
+    }
+    stats.active.set(++active);
+    return true;
+}
+
+void AdmissionQueue::leave() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Hand the slot straight to the oldest waiter, cancels first, so a
+    // newcomer cannot take it in between; a slot held over the limit by
+    // tryEnter is given up instead
+    if (active <= slots) {
+        for (int lane = CANCEL; lane < LANES; ++lane) {
+            if (!queue[lane].empty()) {
+                Waiter* next = queue[lane].front();
+                queue[lane].pop_front();
+                stats.queued[lane].set(static_cast<int64_t>(queue[lane].size()));
+                next->granted = true;
+                next->ready.notify_one();
+                return;
+            }
+        }
+    }
+    stats.active.set(--active);
+}
@@ -0,0 +1,52 @@
+#ifndef ADMISSION_QUEUE_H
+#define ADMISSION_QUEUE_H
+
+#include "metrics.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Bounds how many client threads are inside the matching engine at once.
+// Past that, requests wait in one of two FIFO lanes and a freed slot goes
+// to a waiting cancel before any waiting order, so clients can always pull
+// quotes from a saturated engine. The order lane has a fixed depth beyond
+// which new orders are rejected at once instead of queueing; the cancel
+// lane never sheds, and holds at most one request per connection anyway.
+class AdmissionQueue {
+public:
+    enum Lane { CANCEL, ORDER, LANES };
+
+    explicit AdmissionQueue(AdmissionStats& stats) : stats(stats) {}
+
+    // Not synchronized with enter/leave; configure before serving clients
+    void configure(int slots, int order_depth);
+
+    // Waits for a slot; false without waiting if lane is ORDER and its
+    // queue is full. Every true must be followed by leave().
+    bool enter(Lane lane);
+
+    // For threads that serve many clients and must not block: an order
+    // takes a free slot or is shed, and a cancel takes a slot even when
+    // none is free, so each such thread can hold one over the limit.
+    bool tryEnter(Lane lane);
+    void leave();
+
+private:
+    AdmissionStats& stats;
+
+    // A queued request; it lives on the waiting thread's stack
+    struct Waiter {
+        std::condition_variable ready;
+        bool granted = false;
+    };
+
+    std::mutex mutex;
+    int slots = 1;
+    int order_depth = 0;
+    int active = 0;                    // Slots held, including ones handed to a waiter
+    std::deque<Waiter*> queue[LANES];  // Oldest first; leave() hands a slot to the front
+
+    bool queuedAhead(Lane lane) const;  // Caller holds mutex
+};
+
+#endif // ADMISSION_QUEUE_H
@@ -0,0 +1,201 @@
+// Sweep benchmark for the order book: rests a ladder of sell orders, takes
+// them all out with one buy, and reports cost per fill for each book backend
+// in turn. Hardware counters come from perf_event_open; where the kernel or
+// VM does not expose them (perf_event_paranoid, no PMU) only wall time is
+// reported.
+//
+// Usage: book_bench [all|tree|ticks|ladder] [levels] [orders_per_level] [rounds]
+
+#include "trading_engine.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <iomanip>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace {
+
+struct CounterSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+const CounterSpec COUNTERS[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"L1d-load-misses", PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+const size_t COUNTER_COUNT = sizeof(COUNTERS) / sizeof(COUNTERS[0]);
+
+// User-space counters for this thread, read as one group so they cover the
+// same instructions
+class PerfGroup {
+public:
+    ~PerfGroup() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    bool open(std::string& error) {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = COUNTERS[i].type;
+            attr.config = COUNTERS[i].config;
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            int leader = fds.empty() ? -1 : fds[0];
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                error = std::string(COUNTERS[i].name) + ": " + std::strerror(errno);
+                return false;
+            }
+            fds.push_back(fd);
+        }
+        return true;
+    }
+
+    void start() {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    void stop() { ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP); }
+
+    // Adds this run's counts to totals
+    bool accumulate(uint64_t* totals) {
+        uint64_t values[1 + COUNTER_COUNT];
+        if (::read(fds[0], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) {
+            return false;
+        }
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            totals[i] += values[1 + i];
+        }
+        return true;
+    }
+
+private:
+    std::vector<int> fds;
+};
+
+struct Backend {
+    const char* name;
+    BookType type;
+};
+
+const Backend BACKENDS[] = {
+    {"tree", BookType::TREE},
+    {"ticks", BookType::TICK_TREE},
+    {"ladder", BookType::LADDER},
+};
+
+// Runs the sweep on one backend and prints its per-fill costs
+bool runSweeps(const Backend& backend, int levels, int orders_per_level, int rounds) {
+    TradingEngine engine;
+    engine.setBookType("BENCH", backend.type, 0.01);
+
+    uint64_t fill_events = 0;
+    engine.setFillHandler([&fill_events](const Fill&) { ++fill_events; });
+
+    PerfGroup perf;
+    std::string perf_error;
+    bool have_perf = perf.open(perf_error);
+    if (!have_perf) {
+        std::cout << "perf counters unavailable (" << perf_error << "), reporting time only" << std::endl;
+    }
+
+    const int quantity = 10;
+    const double base_price = 100.00;
+    uint64_t totals[COUNTER_COUNT] = {};
+    std::chrono::nanoseconds elapsed(0);
+
+    for (int round = 0; round < rounds; ++round) {
+        for (int level = 0; level < levels; ++level) {
+            for (int i = 0; i < orders_per_level; ++i) {
+                engine.addOrder("BENCH", OrderSide::SELL, base_price + level * 0.01, quantity);
+            }
+        }
+
+        double sweep_price = base_price + (levels - 1) * 0.01;
+        int sweep_quantity = levels * orders_per_level * quantity;
+
+        auto begin = std::chrono::steady_clock::now();
+        if (have_perf) {
+            perf.start();
+        }
+        engine.addOrder("BENCH", OrderSide::BUY, sweep_price, sweep_quantity);
+        if (have_perf) {
+            perf.stop();
+        }
+        elapsed += std::chrono::steady_clock::now() - begin;
+
+        if (have_perf && !perf.accumulate(totals)) {
+            std::cout << "failed to read perf counters" << std::endl;
+            have_perf = false;
+        }
+    }
+
+    uint64_t fills = fill_events / 2;  // One event per side
+    uint64_t expected = static_cast<uint64_t>(levels) * orders_per_level * rounds;
+    if (fills != expected) {
+        std::cerr << backend.name << ": expected " << expected << " fills, saw " << fills << std::endl;
+        return false;
+    }
+
+    std::cout << "backend=" << backend.name << " levels=" << levels << " orders_per_level=" << orders_per_level
+              << " rounds=" << rounds << "\n";
+    std::cout << "fills: " << fills << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "ns/fill: " << static_cast<double>(elapsed.count()) / fills << "\n";
+    if (have_perf) {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            std::cout << COUNTERS[i].name << "/fill: " << static_cast<double>(totals[i]) / fills << "\n";
+        }
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string backend = argc > 1 ? argv[1] : "all";
+    int levels = argc > 2 ? std::atoi(argv[2]) : 64;
+    int orders_per_level = argc > 3 ? std::atoi(argv[3]) : 64;
+    int rounds = argc > 4 ? std::atoi(argv[4]) : 200;
+
+    std::vector<Backend> selected;
+    for (const Backend& candidate : BACKENDS) {
+        if (backend == "all" || backend == candidate.name) {
+            selected.push_back(candidate);
+        }
+    }
+
+    if (selected.empty() || levels <= 0 || orders_per_level <= 0 || rounds <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [all|tree|ticks|ladder] [levels] [orders_per_level] [rounds]"
+                  << std::endl;
+        return 1;
+    }
+
+    for (const Backend& b : selected) {
+        if (!runSweeps(b, levels, orders_per_level, rounds)) {
+            return 1;
+        }
+    }
+    return 0;
+}
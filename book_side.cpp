@@ -0,0 +1,72 @@
+#include "book_side.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+int64_t nextSetBit(const uint64_t* words, size_t word_count, int64_t from) {
+    if (from < 0) {
+        from = 0;
+    }
+    size_t w = static_cast<size_t>(from) >> 6;
+    if (w >= word_count) {
+        return -1;
+    }
+
+    uint64_t word = words[w] & (~0ULL << (from & 63));
+    if (word != 0) {
+        return static_cast<int64_t>(w << 6) + __builtin_ctzll(word);
+    }
+    ++w;
+
+#ifdef __AVX2__
+    // Four words per test until a block has a bit set
+    for (; w + 4 <= word_count; w += 4) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w));
+        if (!_mm256_testz_si256(block, block)) {
+            break;
+        }
+    }
+#endif
+
+    for (; w < word_count; ++w) {
+        if (words[w] != 0) {
+            return static_cast<int64_t>(w << 6) + __builtin_ctzll(words[w]);
+        }
+    }
+    return -1;
+}
+
+int64_t prevSetBit(const uint64_t* words, size_t word_count, int64_t from) {
+    if (from < 0 || word_count == 0) {
+        return -1;
+    }
+    int64_t last = static_cast<int64_t>(word_count << 6) - 1;
+    if (from > last) {
+        from = last;
+    }
+    int64_t w = from >> 6;
+
+    uint64_t word = words[w] & (~0ULL >> (63 - (from & 63)));
+    if (word != 0) {
+        return (w << 6) + 63 - __builtin_clzll(word);
+    }
+    --w;
+
+#ifdef __AVX2__
+    // Words w-3..w per test, walking down
+    for (; w >= 3; w -= 4) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + w - 3));
+        if (!_mm256_testz_si256(block, block)) {
+            break;
+        }
+    }
+#endif
+
+    for (; w >= 0; --w) {
+        if (words[w] != 0) {
+            return (w << 6) + 63 - __builtin_clzll(words[w]);
+        }
+    }
+    return -1;
+}
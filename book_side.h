@@ -0,0 +1,386 @@
+#ifndef BOOK_SIDE_H
+#define BOOK_SIDE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct Order;
+
+// Hot fields of a resting order, two to a cache line. While the order rests
+// its quantities live here, not in the Order; the matching loop reads only
+// slots and touches the Order behind them for cold fields (STP mode, iceberg
+// slice size) on rare paths.
+struct alignas(32) OrderSlot {
+    Order* order;             // nullptr once the order has left the level
+    int32_t quantity;         // Displayed quantity
+    int32_t hidden_quantity;  // Iceberg reserve
+    int32_t order_id;
+    int32_t owner_id;
+    int32_t session_id;
+};
+
+static_assert(sizeof(OrderSlot) == 32, "OrderSlot should fill half a cache line");
+
+// Orders resting at one price, in time priority, as a contiguous run of slots.
+// Removing an order leaves a hole so the others keep their positions; holes
+// at the front are skipped and dropped in bulk, holes elsewhere are packed
+// away once they outnumber the live orders. A position is base + index and
+// stays valid until remove() reports that it repacked the level.
+struct PriceLevel {
+    static constexpr size_t MIN_COMPACT_HOLES = 32;
+
+    std::vector<OrderSlot> slots;
+    size_t head = 0;           // First live slot when the level is not empty
+    uint64_t base = 0;         // Position of slots[0]
+    size_t live = 0;
+    int64_t total_quantity = 0;
+
+    bool empty() const { return live == 0; }
+    OrderSlot& front() { return slots[head]; }
+    const OrderSlot& front() const { return slots[head]; }
+    OrderSlot& at(uint64_t position) { return slots[position - base]; }
+
+    uint64_t push(const OrderSlot& slot) {
+        slots.push_back(slot);
+        ++live;
+        return base + slots.size() - 1;
+    }
+
+    // Returns true if the remaining slots were repacked to new positions
+    bool remove(uint64_t position) {
+        slots[position - base].order = nullptr;
+        if (--live == 0) {
+            base += slots.size();
+            slots.clear();
+            head = 0;
+            return false;
+        }
+        while (slots[head].order == nullptr) {
+            ++head;
+        }
+
+        size_t holes = slots.size() - live;
+        if (holes < MIN_COMPACT_HOLES || holes < live) {
+            return false;
+        }
+        if (holes == head) {
+            slots.erase(slots.begin(), slots.begin() + head);
+            base += head;
+            head = 0;
+            return false;
+        }
+
+        // Fresh positions, so a stale one can never alias a live order
+        base += slots.size();
+        size_t out = 0;
+        for (size_t i = head; i < slots.size(); ++i) {
+            if (slots[i].order != nullptr) {
+                slots[out++] = slots[i];
+            }
+        }
+        slots.resize(out);
+        head = 0;
+        return true;
+    }
+
+    // f(position, slot) for each live order, front first
+    template <typename F>
+    void forEachOrder(F&& f) const {
+        for (size_t i = head; i < slots.size(); ++i) {
+            if (slots[i].order != nullptr) {
+                f(base + i, slots[i]);
+            }
+        }
+    }
+};
+
+// Bitmap scans used by the ladder. Both return -1 when no bit is set.
+// Built with AVX2 they skip empty 256-bit blocks at a time.
+int64_t nextSetBit(const uint64_t* words, size_t word_count, int64_t from);  // Lowest set bit >= from
+int64_t prevSetBit(const uint64_t* words, size_t word_count, int64_t from);  // Highest set bit <= from
+
+// How a level container keys its prices. DoublePrices keys levels by the
+// price itself and takes any price. TickPrices keys them by whole ticks, so
+// keys compare as integers, and prices must lie on the tick grid.
+struct DoublePrices {
+    using Key = double;
+
+    explicit DoublePrices(double = 0.0) {}
+
+    Key toKey(double price) const { return price; }
+    double toPrice(Key key) const { return key; }
+    bool onGrid(double) const { return true; }
+    double tickSize() const { return 0.0; }
+};
+
+class TickPrices {
+public:
+    using Key = int64_t;
+
+    explicit TickPrices(double tick = 0.01) : tick_size(tick), ticks_per_unit(std::round(1.0 / tick)) {
+        // Dividing by a whole number of ticks per unit gives the same double
+        // as parsing the decimal price; multiplying by the tick may not
+        if (std::fabs(ticks_per_unit * tick - 1.0) > 1e-9) {
+            ticks_per_unit = 0.0;
+        }
+    }
+
+    Key toKey(double price) const { return std::llround(price / tick_size); }
+    double toPrice(Key tick) const { return ticks_per_unit > 0 ? tick / ticks_per_unit : tick * tick_size; }
+
+    bool onGrid(double price) const {
+        double ticks = price / tick_size;
+        return std::fabs(ticks - std::round(ticks)) <= 1e-6;
+    }
+
+    double tickSize() const { return tick_size; }
+
+private:
+    double tick_size;
+    double ticks_per_unit;  // 1 / tick_size when that is whole, else 0
+};
+
+// The level containers below keep one side's price levels ordered best first
+// by Compare (std::greater<> for bids, std::less<> for asks) and share this
+// interface:
+//
+//   empty(), size()              non-empty levels
+//   bestPrice(), bestLevel()     top of this side; the side must not be empty
+//   worstPrice()                 last level; the side must not be empty
+//   find(price)                  level at price, or nullptr
+//   getOrCreate(price)           level at price, created empty if needed
+//   erase(price)                 drops a level once its queue is empty
+//   forEach(f)                   f(price, level) best first, until f returns false
+//   depthAtOrBetter(limit)       quantity resting at limit or better
+//   accepts(price)               whether an order at price can rest here
+//   tickSize()                   price grid, 0 if there is none
+//
+// Each is built from a tick size, which DoublePrices trees ignore.
+
+// Levels in a red-black tree. Every best-level change after a level empties
+// is a tree walk.
+template <typename Compare, typename Prices = DoublePrices>
+class TreeLevels {
+public:
+    explicit TreeLevels(double tick_size = 0.0) : prices(tick_size) {}
+
+    bool empty() const { return levels.empty(); }
+    size_t size() const { return levels.size(); }
+
+    double bestPrice() const { return prices.toPrice(levels.begin()->first); }
+    PriceLevel& bestLevel() { return levels.begin()->second; }
+    const PriceLevel& bestLevel() const { return levels.begin()->second; }
+    double worstPrice() const { return prices.toPrice(levels.rbegin()->first); }
+
+    PriceLevel* find(double price) {
+        auto it = levels.find(prices.toKey(price));
+        return it == levels.end() ? nullptr : &it->second;
+    }
+
+    PriceLevel& getOrCreate(double price) { return levels[prices.toKey(price)]; }
+    void erase(double price) { levels.erase(prices.toKey(price)); }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const auto& [key, level] : levels) {
+            if (!f(prices.toPrice(key), level)) {
+                return;
+            }
+        }
+    }
+
+    int64_t depthAtOrBetter(double limit) const {
+        auto limit_key = prices.toKey(limit);
+        int64_t depth = 0;
+        for (auto it = levels.begin(); it != levels.end() && !Compare()(limit_key, it->first); ++it) {
+            depth += it->second.total_quantity;
+        }
+        return depth;
+    }
+
+    bool accepts(double price) const { return prices.onGrid(price); }
+    double tickSize() const { return prices.tickSize(); }
+
+private:
+    Prices prices;
+    std::map<typename Prices::Key, PriceLevel, Compare> levels;
+};
+// Dense array of levels indexed by tick offset from base_tick, with a bitmap
+// of the non-empty ones. Finding the next best level after one empties, and
+// walking levels for depth, are bit scans rather than tree walks. Prices must
+// lie on the tick grid. The window re-centres or doubles when an order lands
+// outside it, moving levels whole so slot positions stay valid.
+template <typename Compare>
+class LadderLevels {
+public:
+    static constexpr size_t INITIAL_TICKS = 1024;
+    static constexpr int64_t MAX_SPAN_TICKS = 65536;  // Widest spread of prices accepted on one side
+
+    explicit LadderLevels(double tick_size = 0.01) : prices(tick_size), base_tick(0), count(0), best(-1) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    double bestPrice() const { return priceAt(best); }
+    PriceLevel& bestLevel() { return levels[best]; }
+    const PriceLevel& bestLevel() const { return levels[best]; }
+    double worstPrice() const { return priceAt(worstIndex()); }
+
+    PriceLevel* find(double price) {
+        int64_t index = toTick(price) - base_tick;
+        if (index < 0 || index >= static_cast<int64_t>(levels.size()) || !isSet(index)) {
+            return nullptr;
+        }
+        return &levels[index];
+    }
+
+    PriceLevel& getOrCreate(double price) {
+        int64_t tick = toTick(price);
+        ensureRange(tick);
+
+        int64_t index = tick - base_tick;
+        if (!isSet(index)) {
+            occupied[index >> 6] |= 1ULL << (index & 63);
+            ++count;
+            if (best < 0 || better(index, best)) {
+                best = index;
+            }
+        }
+        return levels[index];
+    }
+
+    void erase(double price) {
+        int64_t index = toTick(price) - base_tick;
+        occupied[index >> 6] &= ~(1ULL << (index & 63));
+        --count;
+        if (index == best) {
+            best = count == 0 ? -1 : next(index);
+        }
+    }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (int64_t index = best; index >= 0; index = next(index)) {
+            if (!f(priceAt(index), levels[index])) {
+                return;
+            }
+        }
+    }
+
+    int64_t depthAtOrBetter(double limit) const {
+        int64_t limit_index = toTick(limit) - base_tick;
+        int64_t depth = 0;
+        for (int64_t index = best; index >= 0 && !better(limit_index, index); index = next(index)) {
+            depth += levels[index].total_quantity;
+        }
+        return depth;
+    }
+
+    bool accepts(double price) const {
+        if (!prices.onGrid(price)) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        int64_t tick = toTick(price);
+        int64_t low = std::min(tick, base_tick + lowestIndex());
+        int64_t high = std::max(tick, base_tick + highestIndex());
+        return high - low < MAX_SPAN_TICKS;
+    }
+
+    double tickSize() const { return prices.tickSize(); }
+
+private:
+    static constexpr bool descending = std::is_same<Compare, std::greater<>>::value;
+
+    TickPrices prices;
+    int64_t base_tick;               // Tick of levels[0]
+    std::vector<PriceLevel> levels;
+    std::vector<uint64_t> occupied;  // Bit i set when levels[i] has orders
+    size_t count;
+    int64_t best;                    // Index of the best level, -1 when empty
+
+    int64_t toTick(double price) const { return prices.toKey(price); }
+    double priceAt(int64_t index) const { return prices.toPrice(base_tick + index); }
+    bool isSet(int64_t index) const { return (occupied[index >> 6] >> (index & 63)) & 1; }
+    bool better(int64_t a, int64_t b) const { return descending ? a > b : a < b; }
+
+    int64_t lowestIndex() const { return nextSetBit(occupied.data(), occupied.size(), 0); }
+    int64_t highestIndex() const {
+        return prevSetBit(occupied.data(), occupied.size(), static_cast<int64_t>(levels.size()) - 1);
+    }
+    int64_t worstIndex() const { return descending ? lowestIndex() : highestIndex(); }
+
+    // Next non-empty level after index in priority order
+    int64_t next(int64_t index) const {
+        return descending ? prevSetBit(occupied.data(), occupied.size(), index - 1)
+                          : nextSetBit(occupied.data(), occupied.size(), index + 1);
+    }
+
+    void ensureRange(int64_t tick) {
+        if (levels.empty()) {
+            levels.resize(INITIAL_TICKS);
+            occupied.assign(INITIAL_TICKS / 64, 0);
+            base_tick = tick - INITIAL_TICKS / 2;
+            return;
+        }
+
+        int64_t size = static_cast<int64_t>(levels.size());
+        if (tick >= base_tick && tick < base_tick + size) {
+            return;
+        }
+        if (count == 0) {
+            base_tick = tick - size / 2;
+            return;
+        }
+
+        // Keep the occupied span plus the new tick, centred, with at least
+        // as much free room as span so the next move is some way off
+        int64_t low = std::min(tick, base_tick + lowestIndex());
+        int64_t high = std::max(tick, base_tick + highestIndex());
+        int64_t new_size = size;
+        while (new_size < 2 * (high - low + 1)) {
+            new_size *= 2;
+        }
+        int64_t new_base = low - (new_size - (high - low + 1)) / 2;
+
+        std::vector<PriceLevel> moved(new_size);
+        std::vector<uint64_t> moved_bits(new_size / 64, 0);
+        for (int64_t index = lowestIndex(); index >= 0;
+             index = nextSetBit(occupied.data(), occupied.size(), index + 1)) {
+            int64_t target = index + base_tick - new_base;
+            moved[target] = std::move(levels[index]);
+            moved_bits[target >> 6] |= 1ULL << (target & 63);
+        }
+
+        best += base_tick - new_base;
+        base_tick = new_base;
+        levels.swap(moved);
+        occupied.swap(moved_bits);
+    }
+};
+
+// Book backends: the level container used for both sides of a book
+struct TreeBook {
+    template <typename Compare>
+    using Levels = TreeLevels<Compare, DoublePrices>;
+};
+
+struct TickTreeBook {
+    template <typename Compare>
+    using Levels = TreeLevels<Compare, TickPrices>;
+};
+
+struct LadderBook {
+    template <typename Compare>
+    using Levels = LadderLevels<Compare>;
+};
+
+#endif // BOOK_SIDE_H
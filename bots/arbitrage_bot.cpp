@@ -2,14 +2,14 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
-#include <regex>
+#include <mutex>
 
 class ArbitrageBot : public TradingBot {
 private:
     std::string symbol;
     double target_buy_price;
     double target_sell_price;
-    int position;
+    std::atomic<int> position;  // Updated from FILL pushes
     int trade_size;
     double total_profit;
     
@@ -19,46 +19,35 @@ private:
         bool valid;
     };
     
-    OrderBookSnapshot getOrderBook() {
-        std::string response = sendCommand("SHOW_ORDERS " + symbol);
-        
-        OrderBookSnapshot snapshot = {0.0, 0.0, false};
-        
-        std::regex price_pattern(R"((\d+)\s+@\s+\$(\d+\.\d+))");
-        std::smatch matches;
-        
-        bool in_buy_section = false;
-        bool in_sell_section = false;
-        
-        std::istringstream iss(response);
-        std::string line;
+    // Latest top of book pushed by the server, guarded by book_mutex
+    std::mutex book_mutex;
+    OrderBookSnapshot latest_book;
+    bool subscribed;
+    
+    // Applies a "QUOTE <SYMBOL> <BID> <BID_QTY> <ASK> <ASK_QTY>" line
+    void applyQuote(const std::string& message) {
+        size_t pos = message.find("QUOTE ");
+        if (pos == std::string::npos) {
+            return;
+        }
         
-        while (std::getline(iss, line)) {
-            if (line.find("BUY ORDERS") != std::string::npos) {
-                in_buy_section = true;
-                in_sell_section = false;
-                continue;
-            }
-            if (line.find("SELL ORDERS") != std::string::npos) {
-                in_sell_section = true;
-                in_buy_section = false;
-                continue;
-            }
-            
-            if (std::regex_search(line, matches, price_pattern)) {
-                double price = std::stod(matches[2].str());
-                
-                if (in_buy_section && snapshot.best_bid == 0.0) {
-                    snapshot.best_bid = price;
-                }
-                if (in_sell_section && snapshot.best_ask == 0.0) {
-                    snapshot.best_ask = price;
-                }
-            }
+        std::istringstream iss(message.substr(pos + 6));
+        std::string quote_symbol;
+        double bid, ask;
+        long long bid_qty, ask_qty;
+        if (!(iss >> quote_symbol >> bid >> bid_qty >> ask >> ask_qty) || quote_symbol != symbol) {
+            return;
         }
         
-        snapshot.valid = (snapshot.best_bid > 0.0 || snapshot.best_ask > 0.0);
-        return snapshot;
+        std::lock_guard<std::mutex> lock(book_mutex);
+        latest_book.best_bid = bid;
+        latest_book.best_ask = ask;
+        latest_book.valid = (bid > 0.0 || ask > 0.0);
+    }
+    
+    OrderBookSnapshot getOrderBook() {
+        std::lock_guard<std::mutex> lock(book_mutex);
+        return latest_book;
     }
     
     void executeTrade(const std::string& side, double price) {
@@ -69,24 +58,30 @@ private:
         
         std::string response = sendCommand(cmd.str());
         
-        if (side == "BUY") {
-            position += trade_size;
-            logMessage("✓ BOUGHT " + std::to_string(trade_size) + " @ $" + 
-                      std::to_string(price) + " (Position: " + std::to_string(position) + ")");
-        } else {
-            position -= trade_size;
-            logMessage("✓ SOLD " + std::to_string(trade_size) + " @ $" + 
-                      std::to_string(price) + " (Position: " + std::to_string(position) + ")");
+        // Fills have already been pushed by the time the ack arrives, so pull
+        // whatever is left rather than leave it resting at a stale price
+        size_t id_pos = response.find("(Order ID: ");
+        if (id_pos != std::string::npos) {
+            int order_id = std::stoi(response.substr(id_pos + 11));
+            sendCommandNoResponse("CANCEL " + symbol + " " + std::to_string(order_id));
         }
+        
+        logMessage("✓ " + side + " " + std::to_string(trade_size) + " @ $" + 
+                   std::to_string(price) + " (Position: " + std::to_string(position) + ")");
     }
     
 protected:
     void executeStrategy() override {
+        if (!subscribed) {
+            applyQuote(sendCommand("SUBSCRIBE " + symbol));
+            subscribed = true;
+        }
+        
         OrderBookSnapshot book = getOrderBook();
         
         if (!book.valid) {
             logMessage("Waiting for orders to appear in book...");
-            sleep(2000);
+            waitForEvent(2000);
             return;
         }
         
@@ -117,21 +112,38 @@ protected:
                       " | Total profit: $" + std::to_string(total_profit));
         }
         
-        sleep(500);
+        // Re-evaluate as soon as the top of book moves
+        waitForEvent(500);
+    }
+    
+    void onServerMessage(const std::string& message) override {
+        if (message.compare(0, 5, "QUOTE") == 0) {
+            applyQuote(message);
+            notifyStrategy();
+        } else if (message.compare(0, 4, "FILL") == 0) {
+            // FILL <ID> <SIDE> <QTY> ...
+            std::istringstream iss(message);
+            std::string tag, side;
+            int order_id, quantity;
+            if (iss >> tag >> order_id >> side >> quantity) {
+                position += (side == "BUY") ? quantity : -quantity;
+            }
+        }
     }
     
 public:
     ArbitrageBot(const std::string& ip, int port, const std::string& sym,
-                 double buy_target, double sl_target, int size = 50)
+                 double buy_target, double sell_target, int size = 50)
         : TradingBot("Arbitrage", ip, port),
           symbol(sym), target_buy_price(buy_target), target_sell_price(sell_target),
-          position(0), trade_size(size), total_profit(0.0) {
+          position(0), trade_size(size), total_profit(0.0),
+          latest_book{0.0, 0.0, false}, subscribed(false) {
     }
 };
 
 int main(int argc, char* argv[]) {
-    if (argc != 6) {
-        std::cout << "Usage: " << argv[0] << " <server_ip> <port> <symbol> <buy_target> <sell_target>" << std::endl;
+    if (argc != 6 && argc != 7) {
+        std::cout << "Usage: " << argv[0] << " <server_ip> <port> <symbol> <buy_target> <sell_target> [account]" << std::endl;
         std::cout << "Example: " << argv[0] << " 127.0.0.1 8080 AAPL 149.00 151.00" << std::endl;
         std::cout << "  Buy when price < $149.00, sell when price > $151.00" << std::endl;
         return 1;
@@ -144,6 +156,9 @@ int main(int argc, char* argv[]) {
     double sell_target = std::stod(argv[5]);
     
     ArbitrageBot bot(ip, port, symbol, buy_target, sell_target);
+    if (argc == 7) {
+        bot.setAccount(argv[6]);
+    }
     bot.run();
     
     return 0;
@@ -0,0 +1,259 @@
+#include "async_client.h"
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// FrameReader Implementation
+
+bool FrameReader::feed(const char* data, size_t length, const FrameHandler& on_frame) {
+    buffer.append(data, length);
+
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+        if (buffer[offset] != '#') {
+            return false;
+        }
+
+        size_t header_end = buffer.find('\n', offset);
+        if (header_end == std::string::npos) {
+            break;
+        }
+
+        char* end = nullptr;
+        uint64_t id = std::strtoull(buffer.c_str() + offset + 1, &end, 10);
+        if (*end != ' ') {
+            return false;
+        }
+        size_t payload_length = std::strtoull(end + 1, nullptr, 10);
+
+        size_t payload_start = header_end + 1;
+        if (buffer.size() - payload_start < payload_length) {
+            break;  // Rest of the payload has not arrived yet
+        }
+
+        on_frame(id, buffer.substr(payload_start, payload_length));
+        offset = payload_start + payload_length;
+    }
+
+    buffer.erase(0, offset);
+    return true;
+}
+
+// AsyncClient Implementation
+
+AsyncClient::AsyncClient()
+    : socket_fd(-1), wake_fd(-1), connected(false), next_id(1) {
+}
+
+AsyncClient::~AsyncClient() {
+    disconnect();
+}
+
+bool AsyncClient::connect(const std::string& ip, int port) {
+    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        return false;
+    }
+
+    struct sockaddr_in server_addr;
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip.c_str(), &server_addr.sin_addr);
+
+    if (::connect(socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        close(socket_fd);
+        socket_fd = -1;
+        return false;
+    }
+
+    // Small orders should not wait on Nagle
+    int opt = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+
+    connected = true;
+    io_thread = std::thread(&AsyncClient::ioLoop, this);
+    return true;
+}
+
+void AsyncClient::disconnect() {
+    if (connected) {
+        // Give the server a chance to acknowledge before tearing down
+        send("DISCONNECT").wait_for(std::chrono::seconds(1));
+        connected = false;
+    }
+
+    if (io_thread.joinable()) {
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
+        io_thread.join();
+    }
+
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+}
+
+bool AsyncClient::send(const std::string& command, Callback callback) {
+    bool blocked;
+    {
+        // Checked under the lock: the I/O thread clears connected before
+        // failPending takes it, so no callback is queued after that sweep
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!connected) {
+            return false;
+        }
+        uint64_t id = next_id++;
+        pending[id] = std::move(callback);
+        out_buffer += "#" + std::to_string(id) + " " + command + "\n";
+        blocked = !flushLocked();
+    }
+
+    // Socket buffer is full; let the I/O thread finish the write
+    if (blocked) {
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
+    }
+    return true;
+}
+
+std::future<std::string> AsyncClient::send(const std::string& command) {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> future = promise->get_future();
+
+    if (!send(command, [promise](const std::string& response) { promise->set_value(response); })) {
+        promise->set_value("ERROR: Not connected");
+    }
+    return future;
+}
+
+bool AsyncClient::flushLocked() {
+    while (!out_buffer.empty()) {
+        ssize_t sent = ::send(socket_fd, out_buffer.data(), out_buffer.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno != EAGAIN && errno != EWOULDBLOCK;  // Hard errors surface through recv
+        }
+        out_buffer.erase(0, sent);
+    }
+    return true;
+}
+
+void AsyncClient::dispatch(uint64_t id, const std::string& payload) {
+    if (id == 0) {
+        // The server disconnects sessions that stay silent past its idle
+        // timeout; answering its probes keeps a quiet bot connected
+        if (payload == "HEARTBEAT\n") {
+            send("HEARTBEAT", nullptr);
+            return;
+        }
+        if (unsolicited_handler) {
+            unsolicited_handler(payload);
+        }
+        return;
+    }
+
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pending.find(id);
+        if (it == pending.end()) {
+            return;
+        }
+        callback = std::move(it->second);
+        pending.erase(it);
+    }
+
+    if (callback) {
+        callback(payload);
+    }
+}
+
+void AsyncClient::failPending(const std::string& reason) {
+    std::unordered_map<uint64_t, Callback> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed.swap(pending);
+        out_buffer.clear();
+    }
+
+    for (auto& [id, callback] : failed) {
+        if (callback) {
+            callback(reason);
+        }
+    }
+}
+
+void AsyncClient::ioLoop() {
+    char buffer[16384];
+
+    while (connected) {
+        bool want_write;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            want_write = !out_buffer.empty();
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = socket_fd;
+        fds[0].events = POLLIN | (want_write ? POLLOUT : 0);
+        fds[1].fd = wake_fd;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, 100) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            read(wake_fd, &count, sizeof(count));
+        }
+
+        if (fds[0].revents & POLLOUT) {
+            std::lock_guard<std::mutex> lock(mutex);
+            flushLocked();
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            bool closed = false;
+            while (true) {
+                ssize_t received = recv(socket_fd, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    bool valid = reader.feed(buffer, received, [this](uint64_t id, std::string payload) {
+                        dispatch(id, payload);
+                    });
+                    if (!valid) {
+                        closed = true;
+                        break;
+                    }
+                    continue;
+                }
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                closed = true;  // EOF or hard error
+                break;
+            }
+
+            if (closed) {
+                break;
+            }
+        }
+    }
+
+    connected = false;
+    failPending("ERROR: Disconnected");
+}
@@ -0,0 +1,68 @@
+#ifndef ASYNC_CLIENT_H
+#define ASYNC_CLIENT_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+// Incremental parser for "#<id> <length>\n<payload>" frames. Bytes can be
+// fed in arbitrary chunks; complete frames are handed out as they finish.
+class FrameReader {
+private:
+    std::string buffer;
+
+public:
+    using FrameHandler = std::function<void(uint64_t id, std::string payload)>;
+
+    // Returns false if the stream is not valid framing
+    bool feed(const char* data, size_t length, const FrameHandler& on_frame);
+};
+
+// Pipelined connection to the trading server. Every request is tagged with a
+// correlation ID, so any number may be in flight; responses are matched back
+// to their callback or future on the I/O thread. Unsolicited FILL and QUOTE
+// messages go to the unsolicited handler.
+class AsyncClient {
+public:
+    using Callback = std::function<void(const std::string& response)>;
+
+    AsyncClient();
+    ~AsyncClient();
+
+    bool connect(const std::string& ip, int port);
+    void disconnect();
+    bool isConnected() const { return connected; }
+
+    // Callback runs on the I/O thread; pass nullptr to ignore the response
+    bool send(const std::string& command, Callback callback);
+    std::future<std::string> send(const std::string& command);
+
+    // Install before connect()
+    void setUnsolicitedHandler(Callback handler) { unsolicited_handler = std::move(handler); }
+
+private:
+    int socket_fd;
+    int wake_fd;  // eventfd used to tell the I/O thread there is output queued
+    std::atomic<bool> connected;
+    std::thread io_thread;
+
+    std::mutex mutex;  // Protects everything below
+    std::unordered_map<uint64_t, Callback> pending;
+    uint64_t next_id;
+    std::string out_buffer;
+
+    FrameReader reader;
+    Callback unsolicited_handler;
+
+    void ioLoop();
+    bool flushLocked();
+    void dispatch(uint64_t id, const std::string& payload);
+    void failPending(const std::string& reason);
+};
+
+#endif // ASYNC_CLIENT_H
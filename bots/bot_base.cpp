@@ -1,13 +1,11 @@
 #include "bot_base.h"
+#include "../logger.h"
 #include <iostream>
-#include <cstring>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 
 TradingBot::TradingBot(const std::string& name, const std::string& ip, int port)
-    : socket_fd(-1), server_ip(ip), server_port(port), bot_name(name), running(false) {
+    : server_ip(ip), server_port(port), bot_name(name), running(false),
+      cancel_on_disconnect(false), event_pending(false) {
+    client.setUnsolicitedHandler([this](const std::string& message) { onServerMessage(message); });
 }
 
 TradingBot::~TradingBot() {
@@ -15,87 +13,71 @@ TradingBot::~TradingBot() {
 }
 
 bool TradingBot::connectToServer() {
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_fd < 0) {
-        std::cerr << "[" << bot_name << "] Failed to create socket" << std::endl;
-        return false;
-    }
-    
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(server_port);
-    inet_pton(AF_INET, server_ip.c_str(), &server_addr.sin_addr);
-    
-    if (connect(socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    if (!client.connect(server_ip, server_port)) {
         std::cerr << "[" << bot_name << "] Failed to connect to server at " 
                   << server_ip << ":" << server_port << std::endl;
-        close(socket_fd);
-        socket_fd = -1;
         return false;
     }
     
     logMessage("Connected to trading server");
+    
+    if (!account.empty()) {
+        std::string response = sendCommand("LOGON " + account);
+        if (response.compare(0, 6, "ERROR:") == 0) {
+            logMessage("LOGON failed: " + response);
+        }
+    }
+    if (cancel_on_disconnect) {
+        sendCommand("CANCEL_ON_DISCONNECT ON");
+    }
     return true;
 }
 
 void TradingBot::disconnectFromServer() {
-    if (socket_fd >= 0) {
-        sendCommandNoResponse("DISCONNECT");
-        close(socket_fd);
-        socket_fd = -1;
+    if (client.isConnected()) {
+        client.disconnect();
         logMessage("Disconnected from server");
     }
 }
 
 std::string TradingBot::sendCommand(const std::string& command) {
-    if (socket_fd < 0) {
-        return "ERROR: Not connected";
-    }
-    
-    // Send command
-    std::string cmd = command + "\n";
-    ssize_t sent = send(socket_fd, cmd.c_str(), cmd.length(), 0);
-    if (sent < 0) {
-        return "ERROR: Send failed";
-    }
-    
-    // Receive response
-    char buffer[4096];
-    memset(buffer, 0, sizeof(buffer));
-    ssize_t received = recv(socket_fd, buffer, sizeof(buffer) - 1, 0);
+    std::future<std::string> response = client.send(command);
     
-    if (received <= 0) {
-        return "ERROR: Receive failed";
+    if (response.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        return "ERROR: Timed out waiting for response";
     }
-    
-    return std::string(buffer);
+    return response.get();
 }
 
 bool TradingBot::sendCommandNoResponse(const std::string& command) {
-    if (socket_fd < 0) {
-        return false;
-    }
-    
-    std::string cmd = command + "\n";
-    ssize_t sent = send(socket_fd, cmd.c_str(), cmd.length(), 0);
-    return sent > 0;
+    return client.send(command, nullptr);
+}
+
+bool TradingBot::sendCommandAsync(const std::string& command, AsyncClient::Callback callback) {
+    return client.send(command, std::move(callback));
 }
 
 void TradingBot::sleep(int milliseconds) {
     std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
 }
 
+void TradingBot::notifyStrategy() {
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        event_pending = true;
+    }
+    event_cv.notify_one();
+}
+
+void TradingBot::waitForEvent(int milliseconds) {
+    std::unique_lock<std::mutex> lock(event_mutex);
+    event_cv.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] { return event_pending; });
+    event_pending = false;
+}
+
 void TradingBot::logMessage(const std::string& message) {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-    
-    char time_str[100];
-    std::strftime(time_str, sizeof(time_str), "%H:%M:%S", std::localtime(&time));
-    
-    std::cout << "[" << time_str << "." << ms.count() << "] "
-              << "[" << bot_name << "] " << message << std::endl;
+    // Timestamping and formatting happen on the logger thread
+    LOG_INFO("[{}] {}", bot_name, message);
 }
 
 void TradingBot::run() {
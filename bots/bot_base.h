@@ -5,31 +5,56 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include "async_client.h"
 
 class TradingBot {
 protected:
-    int socket_fd;
+    AsyncClient client;
     std::string server_ip;
     int server_port;
     std::string bot_name;
     
     std::atomic<bool> running;
+    bool cancel_on_disconnect;  // Ask the server to pull our orders if we drop
+    std::string account;        // LOGON name; empty trades on the server's DEFAULT account
+    
+    std::mutex event_mutex;
+    std::condition_variable event_cv;
+    bool event_pending;
     
     bool connectToServer();
     void disconnectFromServer();
     
+    // Blocks until the response arrives (or times out)
     std::string sendCommand(const std::string& command);
     bool sendCommandNoResponse(const std::string& command);
     
+    // Returns immediately; the callback runs on the client's I/O thread
+    bool sendCommandAsync(const std::string& command, AsyncClient::Callback callback);
+    
     virtual void executeStrategy() = 0;
     
+    // FILL and QUOTE pushes from the server, delivered on the I/O thread
+    virtual void onServerMessage(const std::string& message) { (void)message; }
+    
     void sleep(int milliseconds);
+    
+    // Wakes a strategy blocked in waitForEvent; safe to call from the I/O thread
+    void notifyStrategy();
+    // Sleeps up to milliseconds, returning early once notifyStrategy is called
+    void waitForEvent(int milliseconds);
+    
     void logMessage(const std::string& message);
     
 public:
     TradingBot(const std::string& name, const std::string& ip, int port);
     virtual ~TradingBot();
     
+    // Bots sharing an account are kept from trading with each other
+    void setAccount(const std::string& name) { account = name; }
+    
     void run();
     void stop();
 };
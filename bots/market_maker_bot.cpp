@@ -11,6 +11,36 @@ private:
     int order_size;
     double base_price;
     
+    // IDs of our resting quotes, 0 when we have none on that side
+    int buy_order_id;
+    int sell_order_id;
+    
+    void appendQuote(std::stringstream& cmd, const char* side, int order_id, double price) {
+        if (order_id > 0) {
+            cmd << "REPLACE " << symbol << " " << order_id << " ";
+        } else {
+            cmd << "ADD " << side << " " << symbol << " ";
+        }
+        cmd << std::fixed << std::setprecision(2) << price << " " << order_size << "; ";
+    }
+    
+    // Order ID from a "[n] Order added: ... (Order ID: N)" line, 0 if entry n failed
+    int parseOrderId(const std::string& response, int entry) {
+        std::string tag = "[" + std::to_string(entry) + "] ";
+        size_t pos = response.find(tag);
+        if (pos == std::string::npos) {
+            return 0;
+        }
+        
+        size_t line_end = response.find('\n', pos);
+        std::string line = response.substr(pos, line_end - pos);
+        size_t id_pos = line.find("(Order ID: ");
+        if (id_pos == std::string::npos) {
+            return 0;
+        }
+        return std::stoi(line.substr(id_pos + 11));
+    }
+    
     void placeOrders() {
         double buy_price = base_price - spread;
         double sell_price = base_price + spread;
@@ -18,21 +48,17 @@ private:
         buy_price = std::round(buy_price * 100.0) / 100.0;
         sell_price = std::round(sell_price * 100.0) / 100.0;
         
-        // Place buy order
-        std::stringstream buy_cmd;
-        buy_cmd << "ADD_ORDER BUY " << symbol << " " 
-                << std::fixed << std::setprecision(2) << buy_price 
-                << " " << order_size;
-        
-        std::string buy_response = sendCommand(buy_cmd.str());
+        // Refresh both sides of the quote in one round trip, moving the
+        // existing orders where we still have them
+        std::stringstream cmd;
+        cmd << "BATCH ";
+        appendQuote(cmd, "BUY", buy_order_id, buy_price);
+        appendQuote(cmd, "SELL", sell_order_id, sell_price);
         
-        // Place sell order
-        std::stringstream sell_cmd;
-        sell_cmd << "ADD_ORDER SELL " << symbol << " " 
-                 << std::fixed << std::setprecision(2) << sell_price 
-                 << " " << order_size;
+        std::string response = sendCommand(cmd.str());
         
-        std::string sell_response = sendCommand(sell_cmd.str());
+        buy_order_id = parseOrderId(response, 1);
+        sell_order_id = parseOrderId(response, 2);
         
         logMessage("Placed orders: BUY @ $" + std::to_string(buy_price) + 
                    " | SELL @ $" + std::to_string(sell_price));
@@ -44,21 +70,31 @@ protected:
         
         base_price += (std::rand() % 3 - 1) * 0.25;
         
-        sleep(2000);
+        // Requote early if one of our quotes trades
+        waitForEvent(2000);
+    }
+    
+    void onServerMessage(const std::string& message) override {
+        if (message.compare(0, 4, "FILL") == 0) {
+            logMessage("Quote hit: " + message.substr(0, message.size() - 1));
+            notifyStrategy();
+        }
     }
     
 public:
     MarketMakerBot(const std::string& ip, int port, const std::string& sym, 
                    double base, double sprd = 0.50, int size = 50)
         : TradingBot("MarketMaker", ip, port), 
-          symbol(sym), spread(sprd), order_size(size), base_price(base) {
+          symbol(sym), spread(sprd), order_size(size), base_price(base),
+          buy_order_id(0), sell_order_id(0) {
+        cancel_on_disconnect = true;  // Stale quotes should not outlive the bot
         std::srand(std::time(nullptr));
     }
 };
 
 int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        std::cout << "Usage: " << argv[0] << " <server_ip> <port> <symbol> <base_price>" << std::endl;
+    if (argc != 5 && argc != 6) {
+        std::cout << "Usage: " << argv[0] << " <server_ip> <port> <symbol> <base_price> [account]" << std::endl;
         std::cout << "Example: " << argv[0] << " 127.0.0.1 8080 AAPL 150.00" << std::endl;
         return 1;
     }
@@ -69,6 +105,9 @@ int main(int argc, char* argv[]) {
     double base_price = std::stod(argv[4]);
     
     MarketMakerBot bot(ip, port, symbol, base_price);
+    if (argc == 6) {
+        bot.setAccount(argv[5]);
+    }
     bot.run();
     
     return 0;
@@ -46,15 +46,15 @@ private:
             << std::fixed << std::setprecision(2) << price 
             << " " << quantity;
         
-        std::string response = sendCommand(cmd.str());
+        // Don't wait for the ack; it is checked on the I/O thread
+        sendCommandAsync(cmd.str(), [this](const std::string& response) {
+            if (response.find("TRADE EXECUTED") != std::string::npos) {
+                logMessage("✓ Trade matched!");
+            }
+        });
         
         logMessage(side + " " + std::to_string(quantity) + " @ $" + 
                    std::to_string(price));
-        
-        // Check if trade was executed
-        if (response.find("TRADE EXECUTED") != std::string::npos) {
-            logMessage("✓ Trade matched!");
-        }
     }
     
 protected:
@@ -40,8 +40,24 @@ int main(int argc, char* argv[]) {
     std::cout << "Connected to trading server!" << std::endl;
     std::cout << "==================================" << std::endl;
     std::cout << "\nCommands:" << std::endl;
+    std::cout << "  LOGON <ACCOUNT>" << std::endl;
     std::cout << "  ADD_ORDER <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>" << std::endl;
+    std::cout << "  FOK <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>" << std::endl;
+    std::cout << "  ICEBERG <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY> <DISPLAY_QUANTITY>" << std::endl;
+    std::cout << "  STOP <BUY|SELL> <SYMBOL> <STOP_PRICE> <QUANTITY>" << std::endl;
+    std::cout << "  STOP_LIMIT <BUY|SELL> <SYMBOL> <STOP_PRICE> <LIMIT_PRICE> <QUANTITY>" << std::endl;
+    std::cout << "  BATCH ADD <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>; REPLACE <SYMBOL> <ORDER_ID> <PRICE> <QUANTITY>; ..." << std::endl;
+    std::cout << "  CANCEL <SYMBOL> <ORDER_ID>" << std::endl;
+    std::cout << "  CANCEL_ALL [SYMBOL|*] [BUY|SELL]" << std::endl;
+    std::cout << "  CANCEL_ON_DISCONNECT <ON|OFF>" << std::endl;
+    std::cout << "  STP <NONE|CANCEL_NEWEST|CANCEL_OLDEST|CANCEL_BOTH|DECREMENT>" << std::endl;
+    std::cout << "  DENSE_BOOK <SYMBOL> <TICK_SIZE>" << std::endl;
+    std::cout << "  SPREAD <SYMBOL> <BUY_LEG> <SELL_LEG>" << std::endl;
+    std::cout << "  AUCTION_START <SYMBOL>" << std::endl;
+    std::cout << "  AUCTION_UNCROSS <SYMBOL>" << std::endl;
     std::cout << "  SHOW_ORDERS <SYMBOL>" << std::endl;
+    std::cout << "  SHOW_BBO <SYMBOL> [SYMBOL...] | SHOW_BBO *" << std::endl;
+    std::cout << "  HEARTBEAT" << std::endl;
     std::cout << "  DISCONNECT" << std::endl;
     std::cout << std::endl;
     
@@ -0,0 +1,89 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Splits a text command into whitespace-separated fields in place: fields
+// are views into the line, which must outlive the parser, and numbers are
+// read with from_chars. Unlike istream extraction a number must be the
+// whole field ("10.5" is not an int, "12abc" is not a price) and prices
+// must be finite.
+class CommandParser {
+public:
+    explicit CommandParser(std::string_view line) : rest(line) {}
+
+    // Next field, or an empty view once the line is used up
+    std::string_view next() {
+        size_t begin = 0;
+        while (begin < rest.size() && isSpace(rest[begin])) {
+            ++begin;
+        }
+        size_t end = begin;
+        while (end < rest.size() && !isSpace(rest[end])) {
+            ++end;
+        }
+        std::string_view field = rest.substr(begin, end - begin);
+        rest.remove_prefix(end);
+        return field;
+    }
+
+    // Reads the next fields into each of fields in turn, like chained >>;
+    // false if one is missing or malformed
+    template <typename... Fields>
+    bool read(Fields&... fields) {
+        return (readField(fields) && ...);
+    }
+
+    // Everything after the fields read so far
+    std::string_view remainder() const { return rest; }
+
+    static bool parse(std::string_view field, std::string_view& value) {
+        value = field;
+        return !field.empty();
+    }
+
+    static bool parse(std::string_view field, std::string& value) {
+        value.assign(field.data(), field.size());
+        return !field.empty();
+    }
+
+    template <typename Int>
+    static std::enable_if_t<std::is_integral_v<Int>, bool> parse(std::string_view field, Int& value) {
+        skipPlus(field);
+        auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+        return !field.empty() && result.ec == std::errc() && result.ptr == field.data() + field.size();
+    }
+
+    static bool parse(std::string_view field, double& value) {
+        skipPlus(field);
+        auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+        return !field.empty() && result.ec == std::errc() && result.ptr == field.data() + field.size() &&
+               std::isfinite(value);
+    }
+
+private:
+    std::string_view rest;
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+    }
+
+    // from_chars takes no sign for positive numbers; a '-' is left to it
+    static void skipPlus(std::string_view& field) {
+        if (field.size() > 1 && field[0] == '+' && field[1] != '-') {
+            field.remove_prefix(1);
+        }
+    }
+
+    template <typename T>
+    bool readField(T& value) {
+        return parse(next(), value);
+    }
+};
+
+#endif // COMMAND_PARSER_H
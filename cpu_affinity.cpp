@@ -0,0 +1,52 @@
+#include "cpu_affinity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::vector<int> parsed;
+    std::stringstream list(text);
+    std::string range;
+    
+    while (std::getline(list, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            size_t used = 0;
+            int first = std::stoi(range.substr(0, dash), &used);
+            if (used != (dash == std::string::npos ? range.size() : dash)) {
+                return false;
+            }
+            int last = first;
+            if (dash != std::string::npos) {
+                last = std::stoi(range.substr(dash + 1), &used);
+                if (used != range.size() - dash - 1) {
+                    return false;
+                }
+            }
+            if (first < 0 || last < first || last >= CPU_SETSIZE) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                parsed.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    
+    if (parsed.empty()) {
+        return false;
+    }
+    cpus = parsed;
+    return true;
+}
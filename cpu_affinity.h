@@ -0,0 +1,23 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// Pins the calling thread to one CPU; false if the CPU is not usable
+bool pinCurrentThread(int cpu);
+
+// Parses a CPU list such as "2,4-7"; false on malformed input
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+// Spin-wait hint for polling loops: frees pipeline resources for the
+// sibling hyperthread and keeps the exit from the loop cheap
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#endif // CPU_AFFINITY_H
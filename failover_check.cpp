@@ -0,0 +1,378 @@
+// Failover check for replication: starts a primary and a standby server,
+// drives LOGONs and a randomized mix of orders, cancels, batches, spreads
+// and auctions into the primary from several connections at once, waits
+// for the standby to acknowledge the whole journal, then kills the primary
+// with SIGKILL. Once the standby has promoted itself it must show the same
+// books, keep each account's position (an account filled up to its
+// position limit stays there), and number new sessions apart from the old
+// ones (a new session's CANCEL_ALL finds nothing to cancel).
+//
+// Usage: failover_check [server_binary] [commands_per_client] [seed]
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace {
+
+const int CLIENTS = 4;
+const int BATCH = 20;            // Commands sent between waits for their responses
+const int TIMEOUT_MS = 10000;    // For a response, a server to listen, or the standby to catch up
+const char* SYMBOLS[] = {"A", "B", "C", "D", "S"};  // S is the spread A - B; D is a dense book
+const char* SYNC = "SHOW_ORDERS __SYNC__\n";
+const char* SYNCED = "No orders found for symbol: __SYNC__\n";
+
+using Clock = std::chrono::steady_clock;
+
+// Starts the server with args, its output going to log
+pid_t launch(const std::string& binary, const std::vector<std::string>& args, const std::string& log) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    int out = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) {
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+    }
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(binary.c_str()));
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(binary.c_str(), argv.data());
+    _exit(127);
+}
+
+// Connects to 127.0.0.1:port, retrying until the server listens; -1 on timeout
+int connectTo(int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    auto deadline = Clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    while (Clock::now() < deadline) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return -1;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Appends what fd sends to buffer until it holds marker; false on timeout or close
+bool readUntil(int fd, std::string& buffer, const std::string& marker) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    char chunk[65536];
+    while (buffer.find(marker) == std::string::npos) {
+        int wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - Clock::now()).count());
+        pollfd entry{fd, POLLIN, 0};
+        if (wait <= 0 || poll(&entry, 1, wait) <= 0) {
+            return false;
+        }
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+    }
+    return true;
+}
+
+// A plain-text client session
+class Session {
+public:
+    explicit Session(int port) : fd(connectTo(port)) {}
+    ~Session() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool connected() const { return fd >= 0; }
+
+    // Sends commands, one per line, and returns everything received until
+    // the server has answered them all, pushed fills included
+    bool request(const std::string& commands, std::string& response) {
+        std::string buffer;
+        if (!sendAll(fd, commands + SYNC) || !readUntil(fd, buffer, SYNCED)) {
+            return false;
+        }
+        response = buffer.substr(0, buffer.find(SYNCED));
+        return true;
+    }
+
+private:
+    int fd;
+};
+
+// The books and top of book as clients see them
+bool marketState(int port, std::string& state) {
+    Session session(port);
+    std::string commands = "SHOW_BBO *\n";
+    for (const char* symbol : SYMBOLS) {
+        commands += std::string("SHOW_ORDERS ") + symbol + "\n";
+    }
+    commands += "SHOW_ORDERS E\n";
+    return session.connected() && session.request(commands, state);
+}
+
+// Value of an unlabelled sample on the metrics port, or -1
+int64_t metric(int port, const std::string& name) {
+    int fd = connectTo(port);
+    if (fd < 0) {
+        return -1;
+    }
+    std::string page;
+    sendAll(fd, "GET /metrics HTTP/1.0\r\n\r\n");
+    readUntil(fd, page, "\n" + name + " ");
+    close(fd);
+
+    size_t at = page.find("\n" + name + " ");
+    return at == std::string::npos ? -1 : std::atoll(page.c_str() + at + name.size() + 2);
+}
+
+std::string randomCommand(std::mt19937& rng, int max_order_id) {
+    std::ostringstream out;
+    std::string symbol = SYMBOLS[rng() % 5];
+    const char* side = rng() % 2 ? "BUY" : "SELL";
+    // In cents, within the risk price band of outrights; spreads sit around zero
+    int base = symbol == "S" ? 0 : symbol == "D" ? 1000 : 10000;
+    int width = symbol == "S" ? 200 : base / 50;
+    double price = (base + static_cast<int>(rng() % (2 * width + 1)) - width) / 100.0;
+    int quantity = 1 + static_cast<int>(rng() % 10);
+    int order_id = 1 + static_cast<int>(rng() % std::max(max_order_id, 1));
+
+    int op = static_cast<int>(rng() % 100);
+    if (op < 50) {
+        out << "ADD_ORDER " << side << " " << symbol << " " << price << " " << quantity;
+    } else if (op < 55) {
+        out << "FOK " << side << " " << symbol << " " << price << " " << quantity;
+    } else if (op < 60) {
+        out << "ICEBERG " << side << " " << symbol << " " << price << " " << quantity * 4 << " " << quantity;
+    } else if (op < 65 && symbol != "S") {
+        out << "STOP_LIMIT " << side << " " << symbol << " " << price << " " << price << " " << quantity;
+    } else if (op < 73) {
+        out << "BATCH REPLACE " << symbol << " " << order_id << " " << price << " " << quantity << "; ADD "
+            << side << " " << symbol << " " << price << " " << quantity;
+    } else if (op < 97) {
+        out << "CANCEL " << symbol << " " << order_id;
+    } else {
+        out << "CANCEL_ALL " << symbol;
+    }
+    out << "\n";
+    return out.str();
+}
+
+// One connection's share of the load, under its own account
+bool drive(int port, int client, int commands, unsigned seed, std::atomic<int>& issued) {
+    Session session(port);
+    std::string response;
+    if (!session.connected() ||
+        !session.request("LOGON trader" + std::to_string(client) + "\nSTP CANCEL_NEWEST\n", response)) {
+        return false;
+    }
+
+    std::mt19937 rng(seed + client);
+    for (int sent = 0; sent < commands; sent += BATCH) {
+        std::string batch;
+        for (int i = 0; i < BATCH; ++i) {
+            batch += randomCommand(rng, issued.load() * 2);
+        }
+        if (!session.request(batch, response)) {
+            return false;
+        }
+        issued += BATCH;
+    }
+    return true;
+}
+
+// Ten orders of the default maximum size, which together reach the
+// default position limit of 1000000
+std::string fillToLimit(const char* side) {
+    std::string batch = "BATCH ";
+    for (int i = 0; i < 10; ++i) {
+        batch += std::string(i ? "; " : "") + "ADD " + side + " P 1.00 100000";
+    }
+    return batch + "\n";
+}
+
+// Kills whichever servers are still running when the check ends
+class Servers {
+public:
+    ~Servers() {
+        for (pid_t pid : {primary, standby}) {
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+        unlink(socket_path.c_str());
+    }
+
+    pid_t primary = -1;
+    pid_t standby = -1;
+    std::string socket_path;
+};
+
+int fail(const std::string& why) {
+    std::cerr << "failover_check: " << why << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string binary = argc > 1 ? argv[1] : "./trading_server";
+    int commands = argc > 2 ? std::atoi(argv[2]) : 5000;
+    unsigned seed = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 11;
+    if (commands <= 0 || access(binary.c_str(), X_OK) != 0) {
+        std::cerr << "Usage: " << argv[0] << " [server_binary] [commands_per_client] [seed]" << std::endl;
+        return 1;
+    }
+
+    // Ports, socket and logs of this run, apart from other runs'; the logs
+    // are kept if the check fails
+    int base = 20000 + static_cast<int>(getpid() % 10000) * 4;
+    int primary_port = base, primary_metrics = base + 1, standby_port = base + 2, standby_metrics = base + 3;
+    std::string prefix = "/tmp/failover_check." + std::to_string(getpid());
+    std::string primary_log = prefix + ".primary.log", standby_log = prefix + ".standby.log";
+    Servers servers;
+    servers.socket_path = prefix + ".sock";
+    std::string journal = "unix:" + servers.socket_path;
+
+    servers.primary = launch(binary, {"--port", std::to_string(primary_port), "--metrics-port",
+                                      std::to_string(primary_metrics), "--replicate", journal},
+                             primary_log);
+    if (metric(primary_metrics, "replication_sequence") < 0) {
+        return fail("primary did not start; see " + primary_log);
+    }
+    servers.standby = launch(binary, {"--port", std::to_string(standby_port), "--metrics-port",
+                                      std::to_string(standby_metrics), "--standby-of", journal},
+                             standby_log);
+    if (metric(standby_metrics, "replication_sequence") < 0) {
+        return fail("standby did not start; see " + standby_log);
+    }
+
+    std::string response;
+    {
+        Session setup(primary_port);
+        if (!setup.connected() ||
+            !setup.request("SPREAD S A B\nDENSE_BOOK D 0.01\nAUCTION_START E\nADD_ORDER BUY E 10 5\n"
+                           "ADD_ORDER SELL E 9 3\nAUCTION_UNCROSS E\nAUCTION_START E\nADD_ORDER BUY E 10 4\n",
+                           response)) {
+            return fail("setup commands got no response");
+        }
+    }
+
+    std::atomic<int> issued(0);
+    std::atomic<bool> driven(true);
+    std::vector<std::thread> clients;
+    for (int client = 0; client < CLIENTS; ++client) {
+        clients.emplace_back([&, client] {
+            if (!drive(primary_port, client, commands, seed, issued)) {
+                driven = false;
+            }
+        });
+    }
+    for (std::thread& client : clients) {
+        client.join();
+    }
+    if (!driven) {
+        return fail("a client lost its connection to the primary");
+    }
+
+    {
+        Session seller(primary_port), buyer(primary_port);
+        if (!seller.connected() || !seller.request("LOGON seller\n" + fillToLimit("SELL"), response) ||
+            !buyer.connected() || !buyer.request("LOGON buyer\n" + fillToLimit("BUY"), response)) {
+            return fail("position setup got no response");
+        }
+    }
+
+    std::string primary_state;
+    if (!marketState(primary_port, primary_state)) {
+        return fail("primary did not answer SHOW_ORDERS");
+    }
+
+    // Failover only keeps what the standby has applied, so wait for all of it
+    int64_t journaled = metric(primary_metrics, "replication_sequence");
+    auto deadline = Clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    while (metric(primary_metrics, "replication_acked_sequence") != journaled) {
+        if (Clock::now() > deadline) {
+            return fail("standby did not acknowledge sequence " + std::to_string(journaled));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    kill(servers.primary, SIGKILL);
+    waitpid(servers.primary, nullptr, 0);
+    servers.primary = -1;
+
+    std::string promoted_state;
+    if (!marketState(standby_port, promoted_state)) {
+        return fail("standby did not take over; see " + standby_log);
+    }
+    if (promoted_state != primary_state) {
+        std::cerr << "--- primary\n" << primary_state << "--- promoted standby\n" << promoted_state;
+        return fail("promoted books differ from the primary's");
+    }
+
+    Session buyer(standby_port), newcomer(standby_port);
+    std::string over_limit, fresh, cancelled;
+    if (!buyer.connected() || !buyer.request("LOGON buyer\nADD_ORDER BUY P 1.00 1\n", over_limit) ||
+        !newcomer.connected() || !newcomer.request("CANCEL_ALL *\nLOGON newcomer\nADD_ORDER BUY P 1.00 1\n", fresh)) {
+        return fail("promoted standby did not answer orders");
+    }
+    if (over_limit.find("exceed position limit") == std::string::npos) {
+        std::cerr << over_limit;
+        return fail("buyer's position was not carried over");
+    }
+    if (fresh.find("OK: Cancelled 0 orders") == std::string::npos ||
+        fresh.find("Risk reject") != std::string::npos) {
+        std::cerr << fresh;
+        return fail("a new session reached replayed orders, or a new account inherited a position");
+    }
+
+    unlink(primary_log.c_str());
+    unlink(standby_log.c_str());
+    std::cout << "failover_check: " << journaled << " commands journaled from " << CLIENTS
+              << " clients, seed " << seed << "; promoted standby matches the primary" << std::endl;
+    return 0;
+}
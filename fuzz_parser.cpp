@@ -0,0 +1,168 @@
+// Differential fuzz driver for CommandParser, built with ASan and UBSan by
+// make fuzz. Lines are random bytes biased towards command characters, or
+// well-formed ADD_ORDER lines with random numbers. For each one:
+//
+//   - fields from next() are non-empty, hold no whitespace and lie inside
+//     the line, and joining them gives the line's non-space characters
+//   - where read() accepts a line, istream extraction of the same fields
+//     accepts it too and yields the same values; the parser may be stricter
+//   - integers written with to_chars, and finite doubles printed to 17
+//     digits, parse back exactly
+//
+// Usage: fuzz_parser [iterations] [seed]
+
+#include "command_parser.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+const char ALPHABET[] = " \t\r\n0123456789.+-eEABCXYZ_;#infa";
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+std::string randomLine(std::mt19937_64& rng) {
+    std::string line;
+    int length = static_cast<int>(rng() % 48);
+    for (int i = 0; i < length; ++i) {
+        line += rng() % 8 == 0 ? static_cast<char>(rng() % 256) : ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+    }
+    return line;
+}
+
+std::string wellFormedLine(std::mt19937_64& rng) {
+    std::ostringstream out;
+    out << "ADD_ORDER " << (rng() % 2 ? "BUY" : "SELL") << " SYM" << rng() % 100 << " "
+        << static_cast<double>(rng() % 1000000) / 100.0 << " " << static_cast<int64_t>(rng() % 200000) - 10
+        << (rng() % 3 == 0 ? "\r\n" : "\n");
+    return out.str();
+}
+
+bool checkFields(const std::string& line) {
+    std::string joined;
+    CommandParser parser(line);
+    for (std::string_view field = parser.next(); !field.empty(); field = parser.next()) {
+        if (field.data() < line.data() || field.data() + field.size() > line.data() + line.size()) {
+            std::cerr << "field outside the line" << std::endl;
+            return false;
+        }
+        for (char c : field) {
+            if (isSpace(c)) {
+                std::cerr << "field holds whitespace" << std::endl;
+                return false;
+            }
+        }
+        joined.append(field.data(), field.size());
+    }
+
+    std::string expected;
+    for (char c : line) {
+        if (!isSpace(c)) {
+            expected += c;
+        }
+    }
+    if (joined != expected) {
+        std::cerr << "fields do not cover the line" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 1 if both accept and agree, 0 if only istream accepts, -1 on a mismatch
+int compareWithStream(const std::string& line) {
+    std::string_view command, side;
+    std::string symbol;
+    double price = 0.0;
+    int quantity = 0;
+    CommandParser parser(line);
+    bool parsed = parser.read(command, side, symbol, price, quantity);
+
+    std::istringstream in(line);
+    std::string stream_command, stream_side, stream_symbol;
+    double stream_price = 0.0;
+    int stream_quantity = 0;
+    bool streamed = static_cast<bool>(in >> stream_command >> stream_side >> stream_symbol >> stream_price >>
+                                      stream_quantity);
+
+    if (!parsed) {
+        return streamed ? 0 : 1;
+    }
+    if (!streamed || command != stream_command || side != stream_side || symbol != stream_symbol ||
+        price != stream_price || quantity != stream_quantity) {
+        return -1;
+    }
+    return 1;
+}
+
+bool checkRoundTrip(std::mt19937_64& rng) {
+    char buffer[64];
+
+    int64_t integer = static_cast<int64_t>(rng());
+    auto written = std::to_chars(buffer, buffer + sizeof(buffer), integer);
+    int64_t parsed_integer = 0;
+    if (!CommandParser::parse(std::string_view(buffer, written.ptr - buffer), parsed_integer) ||
+        parsed_integer != integer) {
+        std::cerr << "integer " << integer << " did not round-trip" << std::endl;
+        return false;
+    }
+
+    double value;
+    uint64_t bits = rng();
+    std::memcpy(&value, &bits, sizeof(value));
+    if (!std::isfinite(value)) {
+        return true;
+    }
+    std::ostringstream text;
+    text.precision(17);
+    text << value;
+    double parsed_value = 0.0;
+    if (!CommandParser::parse(text.str(), parsed_value) || parsed_value != value) {
+        std::cerr << "double " << text.str() << " did not round-trip" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 2000000;
+    uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 42;
+    if (iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [iterations] [seed]" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    long agreed = 0;
+    long stricter = 0;
+    for (long i = 0; i < iterations; ++i) {
+        std::string line = i % 2 ? wellFormedLine(rng) : randomLine(rng);
+
+        int compared = compareWithStream(line);
+        if (compared < 0) {
+            std::cerr << "Iteration " << i << ": parser and istream disagree on [" << line << "]" << std::endl;
+            return 1;
+        }
+        if (!checkFields(line) || !checkRoundTrip(rng)) {
+            std::cerr << "Iteration " << i << ": [" << line << "]" << std::endl;
+            return 1;
+        }
+        if (compared) {
+            ++agreed;
+        } else {
+            ++stricter;
+        }
+    }
+
+    std::cout << "fuzz_parser: " << iterations << " lines, seed " << seed << ": " << agreed << " agree, "
+              << stricter << " rejected where istream accepts" << std::endl;
+    return 0;
+}
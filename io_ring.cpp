@@ -0,0 +1,245 @@
+#include "io_ring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+IoRing::IoRing()
+    : ring_fd(-1), sq_ring(MAP_FAILED), sq_ring_size(0), sq_head(nullptr), sq_tail(nullptr), sq_array(nullptr),
+      sq_mask(0), sq_entries(0), sqes(nullptr), sqes_size(0), sqe_tail(0), sqe_submitted(0),
+      cq_ring(MAP_FAILED), cq_ring_size(0), cq_head(nullptr), cq_tail(nullptr), cq_mask(0), cqes(nullptr),
+      buf_ring(nullptr), buf_ring_size(0), buf_mask(0), buf_tail(0), buffer_base(nullptr), buffer_size(0),
+      buffer_count(0), buffer_group(0), enter_calls(0) {
+}
+
+IoRing::~IoRing() {
+    if (buf_ring != nullptr) {
+        munmap(buf_ring, buf_ring_size);
+    }
+    if (buffer_base != nullptr) {
+        munmap(buffer_base, buffer_size * buffer_count);
+    }
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+}
+
+bool IoRing::init(unsigned entries, std::string& error) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    // Completions are reaped only in io_uring_enter by this thread, so the
+    // kernel need not interrupt it to run completion work
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ring_fd = static_cast<int>(syscall(SYS_io_uring_setup, entries, &params));
+    if (ring_fd < 0 && errno == EINVAL) {
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(syscall(SYS_io_uring_setup, entries, &params));
+    }
+    if (ring_fd < 0) {
+        error = std::string("io_uring_setup: ") + std::strerror(errno);
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        error = std::string("mmap SQ ring: ") + std::strerror(errno);
+        return false;
+    }
+    cq_ring = single_mmap ? sq_ring
+                          : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+        error = std::string("mmap CQ ring: ") + std::strerror(errno);
+        return false;
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                         IORING_OFF_SQES);
+    if (sqe_map == MAP_FAILED) {
+        error = std::string("mmap SQEs: ") + std::strerror(errno);
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+    char* sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sqe_tail = sqe_submitted = *sq_tail;
+
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+bool IoRing::registerBuffers(uint16_t group_id, unsigned count, unsigned size, std::string& error) {
+    if (count == 0 || (count & (count - 1)) != 0 || count > 32768) {
+        error = "buffer count must be a power of two up to 32768";
+        return false;
+    }
+
+    void* buffers = mmap(nullptr, static_cast<size_t>(count) * size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        error = std::string("mmap buffers: ") + std::strerror(errno);
+        return false;
+    }
+    buffer_base = static_cast<char*>(buffers);
+    buffer_size = size;
+    buffer_count = count;
+    buffer_group = group_id;
+
+    buf_ring_size = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring != MAP_FAILED) {
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+        reg.ring_entries = count;
+        reg.bgid = group_id;
+        if (syscall(SYS_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0) {
+            buf_ring = static_cast<io_uring_buf_ring*>(ring);
+            buf_mask = count - 1;
+            buf_tail = 0;
+            for (unsigned id = 0; id < count; ++id) {
+                recycleBuffer(static_cast<uint16_t>(id));
+            }
+            if (probeBufferRing()) {
+                return true;
+            }
+            syscall(SYS_io_uring_register, ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            buf_ring = nullptr;
+        }
+        munmap(ring, buf_ring_size);
+    }
+
+    provideBuffers(0, count);
+    int result = waitInternal();
+    if (result < 0) {
+        error = std::string("provide buffers: ") + std::strerror(-result);
+        return false;
+    }
+    return true;
+}
+
+// Submits and returns the result of the one internal request queued since
+// the last reap; only used during setup, before any caller requests exist
+int IoRing::waitInternal() {
+    int result = submitAndWait(1);
+    if (result < 0) {
+        return result;
+    }
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return -EAGAIN;
+    }
+    const io_uring_cqe& cqe = cqes[head & cq_mask];
+    result = cqe.res;
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+    }
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return result;
+}
+
+// Receives one byte through the ring; some kernels accept the registration
+// but never select from it
+bool IoRing::probeBufferRing() {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+        return false;
+    }
+    bool works = false;
+    io_uring_sqe* sqe = getSqe();
+    if (send(pair[1], "x", 1, 0) == 1 && sqe != nullptr) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = pair[0];
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffer_group;
+        sqe->user_data = INTERNAL_USER_DATA;
+        works = waitInternal() == 1;
+    }
+    close(pair[0]);
+    close(pair[1]);
+    return works;
+}
+
+void IoRing::provideBuffers(uint16_t first_id, unsigned count) {
+    io_uring_sqe* sqe;
+    while ((sqe = getSqe()) == nullptr) {
+        submitAndWait(0);
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(bufferData(first_id));
+    sqe->len = static_cast<uint32_t>(buffer_size);
+    sqe->off = first_id;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = INTERNAL_USER_DATA;
+}
+
+void IoRing::recycleBuffer(uint16_t buffer_id) {
+    if (buf_ring == nullptr) {
+        // Goes to the kernel with the next submit
+        provideBuffers(buffer_id, 1);
+        return;
+    }
+    io_uring_buf& buf = buf_ring->bufs[buf_tail & buf_mask];
+    buf.addr = reinterpret_cast<uint64_t>(bufferData(buffer_id));
+    buf.len = static_cast<uint32_t>(buffer_size);
+    buf.bid = buffer_id;
+    ++buf_tail;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* IoRing::getSqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries) {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes[sqe_tail & sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sqe_tail;
+    return sqe;
+}
+
+int IoRing::submitAndWait(unsigned wait_for) {
+    unsigned to_submit = sqe_tail - sqe_submitted;
+    for (; sqe_submitted != sqe_tail; ++sqe_submitted) {
+        sq_array[sqe_submitted & sq_mask] = sqe_submitted & sq_mask;
+    }
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    ++enter_calls;
+    int result = static_cast<int>(syscall(SYS_io_uring_enter, ring_fd, to_submit, wait_for,
+                                          IORING_ENTER_GETEVENTS, nullptr, 0));
+    return result < 0 ? -errno : result;
+}
@@ -0,0 +1,109 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing). One thread
+// owns a ring: it takes SQEs, submits and reaps completions. Optionally one
+// group of provided buffers is registered for buffer-select receives;
+// buffers are handed back with recycleBuffer once their data has been
+// consumed.
+class IoRing {
+public:
+    // Completions the ring issues for itself; never passed to callers
+    static constexpr uint64_t INTERNAL_USER_DATA = ~0ULL;
+
+    IoRing();
+    ~IoRing();
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // Sets up a ring with at least entries SQEs; false with error set if the
+    // kernel refuses (too old, io_uring disabled, seccomp)
+    bool init(unsigned entries, std::string& error);
+
+    // Registers count buffers of size bytes as buffer group group_id. Uses a
+    // mapped buffer ring, or IORING_OP_PROVIDE_BUFFERS on kernels where the
+    // ring is missing or does not hand out buffers.
+    bool registerBuffers(uint16_t group_id, unsigned count, unsigned size, std::string& error);
+
+    // Zeroed SQE to fill in, or nullptr if the submission queue is full
+    io_uring_sqe* getSqe();
+
+    // SQEs that can be taken before the next submit; linked chains must fit
+    unsigned sqSpace() const { return sq_entries - (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)); }
+
+    // Submits queued SQEs and waits for at least wait_for completions.
+    // Returns the io_uring_enter result (negative errno on failure).
+    int submitAndWait(unsigned wait_for);
+
+    // Calls f(cqe) for each completion ready now; returns how many
+    template <typename F>
+    unsigned forEachCompletion(F&& f) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned seen = 0;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            if (cqe.user_data != INTERNAL_USER_DATA) {
+                f(cqe);
+                ++seen;
+            }
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return seen;
+    }
+
+    char* bufferData(uint16_t buffer_id) { return buffer_base + static_cast<size_t>(buffer_id) * buffer_size; }
+    void recycleBuffer(uint16_t buffer_id);
+
+    uint64_t enterCalls() const { return enter_calls; }
+    bool mappedBuffers() const { return buf_ring != nullptr; }
+
+private:
+    void provideBuffers(uint16_t first_id, unsigned count);
+    bool probeBufferRing();
+    int waitInternal();
+
+    int ring_fd;
+
+    // Submission queue
+    void* sq_ring;
+    size_t sq_ring_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned sqe_tail;       // Next SQE to hand out
+    unsigned sqe_submitted;  // SQEs already published to the kernel
+
+    // Completion queue
+    void* cq_ring;           // Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe* cqes;
+
+    // Provided buffers; buf_ring is null in IORING_OP_PROVIDE_BUFFERS mode
+    io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    unsigned buf_mask;
+    uint16_t buf_tail;
+    char* buffer_base;
+    size_t buffer_size;
+    size_t buffer_count;
+    uint16_t buffer_group;
+
+    uint64_t enter_calls;
+};
+
+#endif // IO_RING_H
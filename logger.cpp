@@ -0,0 +1,204 @@
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+// Hands the ring back to the logger thread when the owning thread exits
+struct RingOwner {
+    LogRing* ring = nullptr;
+    ~RingOwner() {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO: return "INFO";
+        case LogLevel::WARN: return "WARN";
+        case LogLevel::ERROR: return "ERROR";
+        default: return "";
+    }
+}
+
+}
+
+AsyncLogger::AsyncLogger() : rings(nullptr), min_level(LogLevel::INFO), running(true) {
+    writer_thread = std::thread(&AsyncLogger::writerLoop, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+    running = false;
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+}
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+LogRing* AsyncLogger::threadRing() {
+    thread_local RingOwner owner;
+    if (!owner.ring) {
+        owner.ring = new LogRing();
+        // Lock-free push onto the list the writer walks
+        LogRing* head = rings.load(std::memory_order_relaxed);
+        do {
+            owner.ring->next_ring = head;
+        } while (!rings.compare_exchange_weak(head, owner.ring,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+    return owner.ring;
+}
+
+void AsyncLogger::format(const LogRecord& record, std::string& out) {
+    time_t seconds = record.timestamp_us / 1000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+
+    char prefix[64];
+    size_t len = std::strftime(prefix, sizeof(prefix), "[%H:%M:%S", &local);
+    std::snprintf(prefix + len, sizeof(prefix) - len, ".%03d] [%s] ",
+                  static_cast<int>((record.timestamp_us / 1000) % 1000), levelName(record.level));
+    out += prefix;
+
+    int arg = 0;
+    for (const char* p = record.format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}') {
+            if (arg < record.arg_count) {
+                const LogRecord::Arg& a = record.args[arg++];
+                char number[32];
+                switch (a.type) {
+                    case LogRecord::ArgType::INT:
+                        std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(a.i));
+                        out += number;
+                        break;
+                    case LogRecord::ArgType::UINT:
+                        std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(a.u));
+                        out += number;
+                        break;
+                    case LogRecord::ArgType::DOUBLE:
+                        std::snprintf(number, sizeof(number), "%.2f", a.d);
+                        out += number;
+                        break;
+                    case LogRecord::ArgType::TEXT:
+                        out.append(record.text + a.text.offset, a.text.length);
+                        if (a.text.cut > 0) {
+                            out += "...";
+                        }
+                        break;
+                }
+            }
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+
+    // Received commands already carry their own newline
+    if (out.empty() || out.back() != '\n') {
+        out += '\n';
+    }
+}
+
+size_t AsyncLogger::drain(std::string& out) {
+    std::vector<const LogRecord*> batch;
+    std::vector<std::pair<LogRing*, uint64_t>> consumed;
+
+    for (LogRing* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next_ring) {
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        for (uint64_t i = head; i != tail; ++i) {
+            batch.push_back(&ring->records[i & (LogRing::kCapacity - 1)]);
+        }
+        if (head != tail) {
+            consumed.emplace_back(ring, tail);
+        }
+
+        uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            out += "[LOGGER] dropped " + std::to_string(dropped) + " records\n";
+        }
+        uint64_t truncated = ring->truncated.exchange(0, std::memory_order_relaxed);
+        if (truncated > 0) {
+            out += "[LOGGER] truncated " + std::to_string(truncated) + " records\n";
+        }
+    }
+
+    // Interleave threads in the order things happened
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord* a, const LogRecord* b) {
+        return a->timestamp_us < b->timestamp_us;
+    });
+    for (const LogRecord* record : batch) {
+        format(*record, out);
+    }
+
+    for (auto& [ring, tail] : consumed) {
+        ring->head.store(tail, std::memory_order_release);
+    }
+
+    reclaimRetired();
+
+    return batch.size();
+}
+
+void AsyncLogger::reclaimRetired() {
+    // Only this thread unlinks rings; producers only ever push at the head
+    LogRing* prev = nullptr;
+    LogRing* ring = rings.load(std::memory_order_acquire);
+
+    while (ring) {
+        LogRing* next = ring->next_ring;
+        bool empty = ring->retired.load(std::memory_order_acquire) &&
+                     ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+
+        if (empty) {
+            if (prev) {
+                prev->next_ring = next;
+                delete ring;
+                ring = next;
+                continue;
+            }
+            LogRing* expected = ring;
+            if (rings.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+                delete ring;
+                ring = next;
+                continue;
+            }
+            // A new ring was pushed in front; retry on the next pass
+        }
+
+        prev = ring;
+        ring = next;
+    }
+}
+
+void AsyncLogger::writerLoop() {
+    std::string out;
+
+    while (true) {
+        out.clear();
+        bool stopping = !running.load(std::memory_order_acquire);
+        size_t written = drain(out);
+
+        if (!out.empty()) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+        }
+
+        if (stopping) {
+            break;
+        }
+        if (written == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3,
+    OFF = 4
+};
+
+// Levels below this are removed at compile time. Per-order logging goes
+// through LOG_DEBUG, so default builds pay nothing for it; build with
+// -DLOG_COMPILE_LEVEL=0 to bring it back.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 1
+#endif
+
+// Fixed-size binary log record. The caller only copies the format pointer
+// and raw argument values; turning them into text happens on the logger
+// thread. Format strings must be string literals and use {} placeholders.
+struct LogRecord {
+    static constexpr int kMaxArgs = 8;
+    static constexpr int kTextSize = 152;
+
+    enum class ArgType : uint8_t { INT, UINT, DOUBLE, TEXT };
+
+    struct Arg {
+        ArgType type;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            struct {
+                uint16_t offset;
+                uint16_t length;
+                uint32_t cut;  // bytes that did not fit
+            } text;
+        };
+    };
+
+    int64_t timestamp_us;
+    const char* format;
+    LogLevel level;
+    uint8_t arg_count;
+    uint16_t text_used;
+    bool truncated;
+    Arg args[kMaxArgs];
+    char text[kTextSize];
+
+    void push(bool value) { pushText(value ? "true" : "false"); }
+    void push(double value) { if (Arg* a = next(ArgType::DOUBLE)) a->d = value; }
+    void push(float value) { push(static_cast<double>(value)); }
+    void push(const char* value) { pushText(value ? std::string_view(value) : std::string_view("(null)")); }
+    void push(const std::string& value) { pushText(value); }
+    void push(std::string_view value) { pushText(value); }
+
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>> push(T value) {
+        if (Arg* a = next(ArgType::INT)) a->i = value;
+    }
+
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T> && !std::is_same_v<T, bool>> push(T value) {
+        if (Arg* a = next(ArgType::UINT)) a->u = value;
+    }
+
+private:
+    Arg* next(ArgType type) {
+        if (arg_count >= kMaxArgs) {
+            return nullptr;
+        }
+        Arg* a = &args[arg_count++];
+        a->type = type;
+        return a;
+    }
+
+    // Strings are copied into the record; what doesn't fit is cut off and
+    // the record marked, so the line ends in "..." and is counted
+    void pushText(std::string_view value) {
+        Arg* a = next(ArgType::TEXT);
+        if (!a) {
+            return;
+        }
+        size_t length = std::min<size_t>(value.size(), kTextSize - text_used);
+        std::memcpy(text + text_used, value.data(), length);
+        a->text.offset = text_used;
+        a->text.length = static_cast<uint16_t>(length);
+        a->text.cut = static_cast<uint32_t>(std::min<size_t>(value.size() - length, UINT32_MAX));
+        text_used += static_cast<uint16_t>(length);
+        truncated |= length < value.size();
+    }
+};
+
+// Single-producer/single-consumer ring owned by one logging thread
+struct LogRing {
+    static constexpr size_t kCapacity = 1024;  // power of two
+
+    alignas(64) std::atomic<uint64_t> head{0};  // next slot the consumer reads
+    alignas(64) std::atomic<uint64_t> tail{0};  // next slot the producer writes
+    alignas(64) std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> truncated{0};
+    std::atomic<bool> retired{false};
+    LogRing* next_ring = nullptr;
+
+    LogRecord records[kCapacity];
+};
+
+class AsyncLogger {
+private:
+    std::atomic<LogRing*> rings;
+    std::atomic<LogLevel> min_level;
+    std::atomic<bool> running;
+    std::thread writer_thread;
+
+    AsyncLogger();
+
+    LogRing* threadRing();
+    void writerLoop();
+    size_t drain(std::string& out);
+    void reclaimRetired();
+    static void format(const LogRecord& record, std::string& out);
+
+public:
+    ~AsyncLogger();
+
+    static AsyncLogger& instance();
+
+    void setLevel(LogLevel level) { min_level.store(level, std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= min_level.load(std::memory_order_relaxed); }
+
+    template <typename... Args>
+    void log(LogLevel level, const char* format, const Args&... args) {
+        if (!enabled(level)) {
+            return;
+        }
+
+        LogRing* ring = threadRing();
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->head.load(std::memory_order_acquire) >= LogRing::kCapacity) {
+            // Never block the caller: count it and move on
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogRecord& record = ring->records[tail & (LogRing::kCapacity - 1)];
+        record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record.format = format;
+        record.level = level;
+        record.arg_count = 0;
+        record.text_used = 0;
+        record.truncated = false;
+        (record.push(args), ...);
+        if (record.truncated) {
+            ring->truncated.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+};
+
+constexpr bool logCompiledIn(LogLevel level) {
+    return static_cast<int>(level) - LOG_COMPILE_LEVEL >= 0;
+}
+
+#define LOG_AT(lvl, ...)                                                  \
+    do {                                                                  \
+        if constexpr (logCompiledIn(lvl)) {                               \
+            AsyncLogger::instance().log(lvl, __VA_ARGS__);                \
+        }                                                                 \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::ERROR, __VA_ARGS__)
+
+#endif // LOGGER_H
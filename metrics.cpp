@@ -0,0 +1,38 @@
+#include "metrics.h"
+#include <cstdio>
+
+// ShardedCounter Implementation
+
+int ShardedCounter::shardIndex() {
+    static std::atomic<int> next_shard{0};
+    thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+
+uint64_t ShardedCounter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Prometheus text format
+
+void writeHeader(std::string& out, const std::string& name, const std::string& type, const std::string& help) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+void writeSample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.17g", value);
+
+    out += name;
+    if (!labels.empty()) {
+        out += "{" + labels + "}";
+    }
+    out += " ";
+    out += number;
+    out += "\n";
+}
@@ -0,0 +1,133 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Counter split across cache-line sized shards. Threads are dealt shards
+// round-robin and keep theirs, so up to kShards threads never share a line;
+// past that, threads kShards apart share one. Either way the matching path
+// pays one relaxed fetch_add.
+class ShardedCounter {
+public:
+    static constexpr int kShards = 16;
+
+    void add(uint64_t n = 1) {
+        shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards[kShards];
+
+    static int shardIndex();
+};
+
+// Last-written value, for quantities that go up and down (depth, sessions).
+class Gauge {
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+    // Raise the gauge to v if v is larger (high-water marks)
+    void max(int64_t v) {
+        int64_t cur = value_.load(std::memory_order_relaxed);
+        while (v > cur && !value_.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> value_{0};
+};
+
+// Acquisition and wait-time statistics for one mutex
+struct LockStats {
+    ShardedCounter acquisitions;
+    ShardedCounter contended;
+    ShardedCounter wait_ns;
+    Gauge max_wait_ns;
+};
+
+// RAII lock that only reads the clock when the mutex is already held,
+// so uncontended acquisitions cost the same as a plain lock_guard.
+class TimedLockGuard {
+public:
+    TimedLockGuard(std::mutex& m, LockStats& stats) : mutex(m) {
+        if (!mutex.try_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            mutex.lock();
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            stats.contended.add();
+            stats.wait_ns.add(waited);
+            stats.max_wait_ns.max(waited);
+        }
+        stats.acquisitions.add();
+    }
+    ~TimedLockGuard() { mutex.unlock(); }
+
+    TimedLockGuard(const TimedLockGuard&) = delete;
+    TimedLockGuard& operator=(const TimedLockGuard&) = delete;
+
+private:
+    std::mutex& mutex;
+};
+
+// Occupancy of the AdmissionQueue in front of the engine
+struct AdmissionStats {
+    Gauge active;            // Requests inside the engine
+    Gauge queued[2];         // Waiting, by lane: cancels, orders
+    ShardedCounter shed;     // Orders rejected because their lane was full
+    ShardedCounter wait_ns;  // Time spent queued
+};
+
+struct SymbolMetrics {
+    ShardedCounter orders;
+    ShardedCounter trades;
+    ShardedCounter volume;
+    Gauge bid_orders;
+    Gauge ask_orders;
+    Gauge bid_quantity;
+    Gauge ask_quantity;
+    Gauge bid_levels;
+    Gauge ask_levels;
+    Gauge max_levels;
+    LockStats book_lock;
+};
+
+struct ServerMetrics {
+    ShardedCounter connections;
+    Gauge active_connections;
+    ShardedCounter bytes_in;
+    ShardedCounter bytes_out;
+    ShardedCounter commands;
+    ShardedCounter io_syscalls;  // recv/send, or io_uring_enter with the io_uring backend
+    ShardedCounter throttled;    // Commands rejected by the connection or account rate limit
+    AdmissionStats admission;
+    ShardedCounter heartbeats;        // HEARTBEAT pushes to silent sessions
+    ShardedCounter idle_disconnects;  // Sessions closed for sending nothing
+};
+
+// Replication stream as seen from the primary or the standby
+struct ReplicationStats {
+    Gauge sequence;           // Last command journaled (primary) or applied (standby)
+    Gauge acked_sequence;     // Primary: last sequence the standby reported applied
+    Gauge standby_connected;  // Primary: 1 while a standby is attached
+    Gauge journal_bytes;      // Primary: journal held in memory
+    Gauge lag_us;             // Standby: age of the last command applied when it was applied
+    ShardedCounter bytes;     // Journal bytes sent (primary) or received (standby)
+    ShardedCounter batches;   // Socket writes (primary) or reads (standby) carrying them
+};
+
+// Prometheus text exposition helpers
+void writeHeader(std::string& out, const std::string& name, const std::string& type, const std::string& help);
+void writeSample(std::string& out, const std::string& name, const std::string& labels, double value);
+
+#endif // METRICS_H
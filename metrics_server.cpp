@@ -0,0 +1,235 @@
+#include "metrics_server.h"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+MetricsServer::MetricsServer(TradingEngine* eng, NetworkServer* srv, int p)
+    : engine(eng), server(srv), replication(nullptr), replication_primary(false), server_socket(-1), port(p), running(false),
+      last_commands(0), last_scrape(std::chrono::steady_clock::now()) {
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start() {
+    server_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_socket < 0) {
+        std::cerr << "Failed to create metrics socket" << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Metrics are for local scrapers only
+    struct sockaddr_in server_addr;
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = htons(port);
+
+    if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        std::cerr << "Failed to bind metrics port " << port << std::endl;
+        close(server_socket);
+        server_socket = -1;
+        return false;
+    }
+
+    if (listen(server_socket, 4) < 0) {
+        std::cerr << "Failed to listen on metrics socket" << std::endl;
+        close(server_socket);
+        server_socket = -1;
+        return false;
+    }
+
+    std::cout << "Metrics available at http://127.0.0.1:" << port << "/metrics" << std::endl;
+
+    running = true;
+    accept_thread = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::serve() {
+    char buffer[1024];
+
+    while (running) {
+        int client_socket = accept(server_socket, nullptr, nullptr);
+        if (client_socket < 0) {
+            continue;
+        }
+
+        // One connection at a time is served, so a scraper that connects and
+        // goes quiet is dropped after the timeout rather than holding the rest
+        timeval timeout{CLIENT_TIMEOUT_SECONDS, 0};
+        setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // The request itself is ignored; every path returns the metrics page
+        recv(client_socket, buffer, sizeof(buffer), 0);
+
+        std::string body = render();
+        std::string response = "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+
+        send(client_socket, response.c_str(), response.length(), MSG_NOSIGNAL);
+        close(client_socket);
+    }
+}
+
+std::string MetricsServer::render() {
+    std::string out;
+
+    std::vector<std::pair<std::string, const SymbolMetrics*>> books;
+    engine->collectMetrics(books);
+
+    auto perSymbol = [&](const std::string& name, const std::string& type, const std::string& help,
+                         auto value) {
+        writeHeader(out, name, type, help);
+        for (const auto& [symbol, m] : books) {
+            writeSample(out, name, "symbol=\"" + symbol + "\"", value(*m));
+        }
+    };
+
+    auto perSide = [&](const std::string& name, const std::string& help,
+                       const Gauge SymbolMetrics::*bid, const Gauge SymbolMetrics::*ask) {
+        writeHeader(out, name, "gauge", help);
+        for (const auto& [symbol, m] : books) {
+            writeSample(out, name, "symbol=\"" + symbol + "\",side=\"buy\"", (m->*bid).value());
+            writeSample(out, name, "symbol=\"" + symbol + "\",side=\"sell\"", (m->*ask).value());
+        }
+    };
+
+    perSymbol("matching_orders_total", "counter", "Orders accepted into the book",
+              [](const SymbolMetrics& m) { return m.orders.value(); });
+    perSymbol("matching_trades_total", "counter", "Trades executed",
+              [](const SymbolMetrics& m) { return m.trades.value(); });
+    perSymbol("matching_volume_total", "counter", "Quantity traded",
+              [](const SymbolMetrics& m) { return m.volume.value(); });
+    perSide("matching_resting_orders", "Orders resting in the book",
+            &SymbolMetrics::bid_orders, &SymbolMetrics::ask_orders);
+    perSide("matching_resting_quantity", "Quantity resting in the book",
+            &SymbolMetrics::bid_quantity, &SymbolMetrics::ask_quantity);
+    perSide("matching_price_levels", "Distinct price levels in the book",
+            &SymbolMetrics::bid_levels, &SymbolMetrics::ask_levels);
+    perSymbol("matching_price_levels_max", "gauge", "High-water mark of price levels on either side",
+              [](const SymbolMetrics& m) { return m.max_levels.value(); });
+
+    perSymbol("matching_book_lock_acquisitions_total", "counter", "book_mutex acquisitions",
+              [](const SymbolMetrics& m) { return m.book_lock.acquisitions.value(); });
+    perSymbol("matching_book_lock_contended_total", "counter", "book_mutex acquisitions that had to wait",
+              [](const SymbolMetrics& m) { return m.book_lock.contended.value(); });
+    perSymbol("matching_book_lock_wait_seconds_total", "counter", "Time spent waiting for book_mutex",
+              [](const SymbolMetrics& m) { return m.book_lock.wait_ns.value() / 1e9; });
+    perSymbol("matching_book_lock_wait_seconds_max", "gauge", "Longest single wait for book_mutex",
+              [](const SymbolMetrics& m) { return m.book_lock.max_wait_ns.value() / 1e9; });
+
+    const LockStats& engine_lock = engine->engineLockStats();
+    writeHeader(out, "matching_engine_lock_acquisitions_total", "counter", "engine_mutex acquisitions");
+    writeSample(out, "matching_engine_lock_acquisitions_total", "", engine_lock.acquisitions.value());
+    writeHeader(out, "matching_engine_lock_contended_total", "counter", "engine_mutex acquisitions that had to wait");
+    writeSample(out, "matching_engine_lock_contended_total", "", engine_lock.contended.value());
+    writeHeader(out, "matching_engine_lock_wait_seconds_total", "counter", "Time spent waiting for engine_mutex");
+    writeSample(out, "matching_engine_lock_wait_seconds_total", "", engine_lock.wait_ns.value() / 1e9);
+    writeHeader(out, "matching_engine_lock_wait_seconds_max", "gauge", "Longest single wait for engine_mutex");
+    writeSample(out, "matching_engine_lock_wait_seconds_max", "", engine_lock.max_wait_ns.value() / 1e9);
+
+    const ServerMetrics& sm = server->getMetrics();
+    writeHeader(out, "server_connections_total", "counter", "Client connections accepted");
+    writeSample(out, "server_connections_total", "", sm.connections.value());
+    writeHeader(out, "server_active_connections", "gauge", "Currently connected clients");
+    writeSample(out, "server_active_connections", "", sm.active_connections.value());
+    writeHeader(out, "server_bytes_received_total", "counter", "Bytes read from clients");
+    writeSample(out, "server_bytes_received_total", "", sm.bytes_in.value());
+    writeHeader(out, "server_bytes_sent_total", "counter", "Bytes written to clients");
+    writeSample(out, "server_bytes_sent_total", "", sm.bytes_out.value());
+
+    uint64_t commands = sm.commands.value();
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_scrape).count();
+    double rate = elapsed > 0 ? (commands - last_commands) / elapsed : 0.0;
+    last_commands = commands;
+    last_scrape = now;
+
+    writeHeader(out, "server_commands_total", "counter", "Commands processed");
+    writeSample(out, "server_commands_total", "", commands);
+    writeHeader(out, "server_commands_per_second", "gauge", "Command rate since the previous scrape");
+    writeSample(out, "server_commands_per_second", "", rate);
+    writeHeader(out, "server_io_syscalls_total", "counter", "Socket I/O system calls made for clients");
+    writeSample(out, "server_io_syscalls_total", "", sm.io_syscalls.value());
+    writeHeader(out, "server_throttled_total", "counter", "Commands rejected by a connection or account rate limit");
+    writeSample(out, "server_throttled_total", "", sm.throttled.value());
+    writeHeader(out, "server_engine_requests_active", "gauge", "Requests inside the matching engine");
+    writeSample(out, "server_engine_requests_active", "", sm.admission.active.value());
+    writeHeader(out, "server_engine_queue_depth", "gauge", "Requests waiting to enter the matching engine");
+    writeSample(out, "server_engine_queue_depth", "lane=\"cancel\"", sm.admission.queued[AdmissionQueue::CANCEL].value());
+    writeSample(out, "server_engine_queue_depth", "lane=\"order\"", sm.admission.queued[AdmissionQueue::ORDER].value());
+    writeHeader(out, "server_engine_queue_wait_seconds_total", "counter", "Time requests spent waiting to enter the engine");
+    writeSample(out, "server_engine_queue_wait_seconds_total", "", sm.admission.wait_ns.value() / 1e9);
+    writeHeader(out, "server_shed_total", "counter", "Orders rejected because the engine queue was full");
+    writeSample(out, "server_shed_total", "", sm.admission.shed.value());
+    writeHeader(out, "server_heartbeats_total", "counter", "HEARTBEAT messages sent to silent sessions");
+    writeSample(out, "server_heartbeats_total", "", sm.heartbeats.value());
+    writeHeader(out, "server_idle_disconnects_total", "counter", "Sessions disconnected after the idle timeout");
+    writeSample(out, "server_idle_disconnects_total", "", sm.idle_disconnects.value());
+
+    if (const RiskManager* risk = server->getRiskManager()) {
+        const RiskStats& rs = risk->getStats();
+        writeHeader(out, "risk_checks_total", "counter", "Pre-trade risk checks run");
+        writeSample(out, "risk_checks_total", "", rs.checks.value());
+        writeHeader(out, "risk_rejects_total", "counter", "Orders rejected by pre-trade risk");
+        writeSample(out, "risk_rejects_total", "reason=\"order_size\"", rs.order_size_rejects.value());
+        writeSample(out, "risk_rejects_total", "reason=\"notional\"", rs.notional_rejects.value());
+        writeSample(out, "risk_rejects_total", "reason=\"price_band\"", rs.price_band_rejects.value());
+        writeSample(out, "risk_rejects_total", "reason=\"position\"", rs.position_rejects.value());
+        writeSample(out, "risk_rejects_total", "reason=\"open_orders\"", rs.open_order_rejects.value());
+        writeSample(out, "risk_rejects_total", "reason=\"rate\"", rs.rate_rejects.value());
+    }
+
+    if (replication) {
+        const ReplicationStats& rs = *replication;
+        writeHeader(out, "replication_sequence", "gauge",
+                    replication_primary ? "Last engine command journaled" : "Last engine command applied");
+        writeSample(out, "replication_sequence", "", rs.sequence.value());
+        writeHeader(out, "replication_bytes_total", "counter", "Journal bytes streamed");
+        writeSample(out, "replication_bytes_total", "", rs.bytes.value());
+        writeHeader(out, "replication_batches_total", "counter", "Socket transfers carrying the journal");
+        writeSample(out, "replication_batches_total", "", rs.batches.value());
+        if (replication_primary) {
+            writeHeader(out, "replication_standby_connected", "gauge", "Whether a standby is attached");
+            writeSample(out, "replication_standby_connected", "", rs.standby_connected.value());
+            writeHeader(out, "replication_journal_bytes", "gauge", "Journal held in memory for a standby");
+            writeSample(out, "replication_journal_bytes", "", rs.journal_bytes.value());
+            writeHeader(out, "replication_acked_sequence", "gauge", "Last command the standby reported applied");
+            writeSample(out, "replication_acked_sequence", "", rs.acked_sequence.value());
+            writeHeader(out, "replication_lag_commands", "gauge", "Commands journaled but not yet applied by the standby");
+            writeSample(out, "replication_lag_commands", "", rs.sequence.value() - rs.acked_sequence.value());
+        } else {
+            writeHeader(out, "replication_lag_seconds", "gauge", "Age of the last command when the standby applied it");
+            writeSample(out, "replication_lag_seconds", "", rs.lag_us.value() / 1e6);
+        }
+    }
+
+    return out;
+}
+
+void MetricsServer::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    if (server_socket >= 0) {
+        shutdown(server_socket, SHUT_RDWR);
+        close(server_socket);
+        server_socket = -1;
+    }
+
+    if (accept_thread.joinable()) {
+        accept_thread.join();
+    }
+}
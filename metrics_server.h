@@ -0,0 +1,48 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include "trading_engine.h"
+#include "network_server.h"
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// Serves engine and server metrics in Prometheus text format on a
+// loopback-only port. Runs on its own thread and only reads counters,
+// so scrapes never take part in matching.
+class MetricsServer {
+private:
+    static constexpr int CLIENT_TIMEOUT_SECONDS = 2;  // Per scrape, for the request and the response
+
+    TradingEngine* engine;
+    NetworkServer* server;
+    const ReplicationStats* replication;  // Null unless replicating
+    bool replication_primary;
+    int server_socket;
+    int port;
+    std::atomic<bool> running;
+    std::thread accept_thread;
+
+    // Previous scrape, used to derive commands/sec
+    uint64_t last_commands;
+    std::chrono::steady_clock::time_point last_scrape;
+
+    void serve();
+    std::string render();
+
+public:
+    MetricsServer(TradingEngine* eng, NetworkServer* srv, int p);
+    ~MetricsServer();
+
+    // Exports the replication stream from this end; call before start()
+    void setReplication(const ReplicationStats* stats, bool primary) {
+        replication = stats;
+        replication_primary = primary;
+    }
+
+    bool start();
+    void stop();
+};
+
+#endif // METRICS_SERVER_H
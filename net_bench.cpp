@@ -0,0 +1,183 @@
+// Load generator for the trading server: each connection pipelines tagged
+// ADD_ORDER commands, keeping up to window requests outstanding, and the run
+// reports acknowledged orders per second. Orders alternate BUY/SELL at one
+// price on a per-connection symbol, so books stay shallow and every other
+// order trades. Run it unchanged against both I/O backends to compare them.
+//
+// Usage: net_bench [host] [port] [connections] [orders_per_connection] [window]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace {
+
+struct Config {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 4;
+    int orders = 100000;
+    int window = 64;
+};
+
+int connectTo(const Config& config) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr) != 1 ||
+        connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Reads "#<id> <length>\n<payload>" frames; counts responses and skips the
+// id 0 pushes (FILL) that trades generate
+class FrameReader {
+public:
+    explicit FrameReader(int s) : sock(s) {}
+
+    // Blocks until at least one more response arrives; false on EOF or error
+    bool readResponses(int& responses) {
+        char chunk[16384];
+        ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+
+        size_t pos = 0;
+        while (true) {
+            size_t newline = buffer.find('\n', pos);
+            if (newline == std::string::npos || buffer[pos] != '#') {
+                break;
+            }
+            size_t space = buffer.find(' ', pos);
+            unsigned long long id = std::strtoull(buffer.c_str() + pos + 1, nullptr, 10);
+            size_t length = std::strtoull(buffer.c_str() + space + 1, nullptr, 10);
+            if (buffer.size() < newline + 1 + length) {
+                break;
+            }
+            pos = newline + 1 + length;
+            if (id != 0) {
+                ++responses;
+            }
+        }
+        buffer.erase(0, pos);
+        return true;
+    }
+
+private:
+    int sock;
+    std::string buffer;
+};
+
+// One connection's run; returns false if the server went away early
+bool runConnection(const Config& config, int index) {
+    int sock = connectTo(config);
+    if (sock < 0) {
+        std::cerr << "connection " << index << ": cannot connect to " << config.host << ":" << config.port
+                  << std::endl;
+        return false;
+    }
+
+    std::string symbol = "NB" + std::to_string(index);
+    FrameReader reader(sock);
+    int sent = 0;
+    int acknowledged = 0;
+    bool ok = true;
+
+    while (acknowledged < config.orders) {
+        // Top the pipeline up to the window in one write
+        std::string batch;
+        while (sent < config.orders && sent - acknowledged < config.window) {
+            batch += "#" + std::to_string(sent + 1) + " ADD_ORDER " + (sent % 2 == 0 ? "BUY " : "SELL ") + symbol +
+                     " 100.00 10\n";
+            ++sent;
+        }
+        size_t offset = 0;
+        while (offset < batch.size()) {
+            ssize_t n = send(sock, batch.data() + offset, batch.size() - offset, MSG_NOSIGNAL);
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            offset += n;
+        }
+        if (!ok || !reader.readResponses(acknowledged)) {
+            ok = false;
+            break;
+        }
+    }
+
+    close(sock);
+    if (!ok) {
+        std::cerr << "connection " << index << ": server closed the connection after " << acknowledged
+                  << " responses" << std::endl;
+    }
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    if (argc > 1) config.host = argv[1];
+    if (argc > 2) config.port = std::atoi(argv[2]);
+    if (argc > 3) config.connections = std::atoi(argv[3]);
+    if (argc > 4) config.orders = std::atoi(argv[4]);
+    if (argc > 5) config.window = std::atoi(argv[5]);
+
+    if (config.port <= 0 || config.connections <= 0 || config.orders <= 0 || config.window <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [host] [port] [connections] [orders_per_connection] [window]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.connections; ++i) {
+        threads.emplace_back([&config, &failures, i]() {
+            if (!runConnection(config, i)) {
+                ++failures;
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if (failures > 0) {
+        return 1;
+    }
+    uint64_t total = static_cast<uint64_t>(config.connections) * config.orders;
+    std::cout << "connections=" << config.connections << " orders_per_connection=" << config.orders
+              << " window=" << config.window << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "orders: " << total << " in " << seconds << " s\n";
+    std::cout << "orders/s: " << total / seconds << std::endl;
+    return 0;
+}
@@ -1,14 +1,136 @@
 #include "network_server.h"
+#include "logger.h"
+#include "cpu_affinity.h"
+#include "io_ring.h"
+#include "shm_gateway.h"
+#include "command_parser.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
+#include <cctype>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
+
+namespace {
+
+void appendFrameHeader(std::string& out, uint64_t id, size_t length) {
+    out += '#';
+    out += std::to_string(id);
+    out += ' ';
+    out += std::to_string(length);
+    out += '\n';
+}
+
+std::string frame(uint64_t id, const std::string& payload) {
+    std::string framed;
+    framed.reserve(payload.size() + 32);
+    appendFrameHeader(framed, id, payload.size());
+    framed += payload;
+    return framed;
+}
+
+bool parseSide(std::string_view text, OrderSide& side) {
+    if (text == "BUY") {
+        side = OrderSide::BUY;
+    } else if (text == "SELL") {
+        side = OrderSide::SELL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string formatQuote(const Quote& quote) {
+    std::stringstream msg;
+    // Implied quotes name the spread they come through after the symbol
+    msg << (quote.spread.empty() ? "QUOTE " : "IMPLIED ") << quote.symbol << " ";
+    if (!quote.spread.empty()) {
+        msg << quote.spread << " ";
+    }
+    msg << std::fixed << std::setprecision(2)
+        << quote.bid_price << " " << quote.bid_quantity << " "
+        << quote.ask_price << " " << quote.ask_quantity << "\n";
+    return msg.str();
+}
+
+// Idle checks run at a fraction of the shortest interval they enforce
+std::chrono::milliseconds idleCheckTick(const NetworkOptions& options) {
+    int interval = options.heartbeat_ms > 0 ? options.heartbeat_ms : options.idle_timeout_ms;
+    return std::chrono::milliseconds(std::clamp(interval / 8, 1, 1000));
+}
+
+constexpr size_t IDLE_TIMER_SLOTS = 512;
+
+// Queue lane for commands that enter the matching engine; false for ones
+// that only read or change session state
+bool engineLane(std::string_view cmd, AdmissionQueue::Lane& lane) {
+    if (cmd == "CANCEL" || cmd == "CANCEL_ALL") {
+        lane = AdmissionQueue::CANCEL;
+        return true;
+    }
+    if (cmd == "ADD_ORDER" || cmd == "FOK" || cmd == "ICEBERG" || cmd == "STOP" || cmd == "STOP_LIMIT" ||
+        cmd == "BATCH" || cmd == "AUCTION_START" || cmd == "AUCTION_UNCROSS" || cmd == "SPREAD" ||
+        cmd == "DENSE_BOOK") {
+        lane = AdmissionQueue::ORDER;
+        return true;
+    }
+    return false;
+}
+
+// io_uring backend: completions carry the operation and session in user_data
+enum UringOp : uint64_t { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_CANCEL, OP_WAKE, OP_TIMER };
+
+uint64_t userData(UringOp op, int session_id, unsigned index = 0) {
+    return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(index) << 32) |
+           static_cast<uint32_t>(session_id);
+}
+
+constexpr unsigned URING_ENTRIES = 256;
+constexpr unsigned RECV_BUFFERS = 256;        // Provided buffers shared by all receives
+constexpr unsigned RECV_BUFFER_SIZE = 4096;
+constexpr uint16_t RECV_GROUP = 0;
+constexpr size_t MAX_SEND_CHAIN = 16;         // Sends per linked chain
+constexpr size_t SEND_COALESCE_BYTES = 16 * 1024;
+
+// Reactor-side state for one connection
+struct UringConnection {
+    std::shared_ptr<Session> session;
+    bool receiving = false;              // Multishot recv is armed
+    bool closing = false;                // No more input is processed
+    std::vector<std::string> in_flight;  // Messages of the send chain being written
+    std::vector<int> results;            // Their send results, in chain order
+    size_t completions = 0;
+};
 
-NetworkServer::NetworkServer(TradingEngine* eng, int p) 
-    : engine(eng), server_socket(-1), port(p), running(false) {
+}
+
+NetworkServer::NetworkServer(TradingEngine* eng, int p, RiskManager* rm, const NetworkOptions& opts)
+    : engine(eng), risk(rm), options(opts), server_socket(-1), port(p), running(false), next_session_id(1),
+      admission(metrics.admission), idle_timers(idleCheckTick(opts), IDLE_TIMER_SLOTS), gateway(nullptr), uring_active(false), wake_fd(-1) {
+    engine->setFillHandler([this](const Fill& fill) { onFill(fill); });
+    engine->setCancelHandler([this](const OrderCancel& cancel) { onCancel(cancel); });
+    engine->setQuoteHandler([this](const Quote& quote) { onQuote(quote); });
+    
+    if (options.idle_timeout_ms == 0) {
+        options.idle_timeout_ms = 3 * options.heartbeat_ms;
+    }
+    
+    int slots = options.engine_slots > 0 ? options.engine_slots : static_cast<int>(std::thread::hardware_concurrency());
+    admission.configure(slots, options.order_queue_depth);
+    
+    if (risk && options.account_rate > 0) {
+        account_limits = std::make_unique<TokenBucket[]>(RiskManager::MAX_ACCOUNTS);
+        for (int i = 0; i < RiskManager::MAX_ACCOUNTS; ++i) {
+            account_limits[i].configure(options.account_rate, options.account_burst);
+        }
+    }
 }
 
 NetworkServer::~NetworkServer() {
@@ -51,11 +173,35 @@ void NetworkServer::start() {
     std::cout << "Waiting for clients to connect..." << std::endl;
     std::cout << "==================================" << std::endl;
     
+    if (options.accept_cpu >= 0 && !pinCurrentThread(options.accept_cpu)) {
+        LOG_WARN("[SERVER] Could not pin accept thread to CPU {}", options.accept_cpu);
+    }
+    
     running = true;
+    if (options.use_uring && serveUring()) {
+        return;
+    }
     acceptClients();
 }
 
+void NetworkServer::configureClientSocket(int client_socket) {
+    // Responses and pushes are small writes; without this Nagle holds the
+    // second one back until the client's delayed ACK
+    int one = 1;
+    setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    
+    if (options.busy_poll_usec > 0 &&
+        setsockopt(client_socket, SOL_SOCKET, SO_BUSY_POLL, &options.busy_poll_usec,
+                   sizeof(options.busy_poll_usec)) < 0) {
+        LOG_WARN("[SERVER] SO_BUSY_POLL not applied: {}", std::strerror(errno));
+    }
+}
+
 void NetworkServer::acceptClients() {
+    if (idleChecksEnabled()) {
+        supervisor = std::thread(&NetworkServer::superviseSessions, this);
+    }
+    
     while (running) {
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
@@ -66,114 +212,1170 @@ void NetworkServer::acceptClients() {
         
         if (client_socket < 0) {
             if (running) {
-                std::cerr << "Failed to accept client" << std::endl;
+                LOG_ERROR("[SERVER] Failed to accept client");
             }
             continue;
         }
         
-        std::cout << "\n[SERVER] Client connected from " 
-                  << inet_ntoa(client_addr.sin_addr) << std::endl;
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+        LOG_INFO("[SERVER] Client connected from {}", client_ip);
+        
+        configureClientSocket(client_socket);
         
+        auto session = std::make_shared<Session>(next_session_id++, client_socket);
+        session->rate_limit.configure(options.session_rate, options.session_burst);
+        session->last_input = std::chrono::steady_clock::now().time_since_epoch().count();
         {
             std::lock_guard<std::mutex> lock(clients_mutex);
-            client_sockets.push_back(client_socket);
+            sessions[session->session_id] = session;
+        }
+        
+        metrics.connections.add();
+        metrics.active_connections.add(1);
+        if (idleChecksEnabled()) {
+            watchIdle(session->session_id, std::chrono::steady_clock::now());
         }
         
         // Spawn thread to handle this client
-        std::thread client_thread(&NetworkServer::handleClient, this, client_socket);
+        std::thread client_thread(&NetworkServer::handleClient, this, session);
         client_thread.detach();  // Let it run independently
     }
 }
 
-void NetworkServer::handleClient(int client_socket) {
-    char buffer[1024];
+// Serves every client from this thread with one ring: multishot accept,
+// multishot receives into provided buffers and linked send chains. Returns
+// false without serving anyone if the ring cannot be set up.
+bool NetworkServer::serveUring() {
+    // Declared before the ring so send buffers outlive its teardown
+    std::unordered_map<int, UringConnection> connections;
+    
+    IoRing ring;
+    std::string error;
+    if (!ring.init(URING_ENTRIES, error) ||
+        !ring.registerBuffers(RECV_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE, error)) {
+        LOG_WARN("[SERVER] io_uring unavailable ({}), using a thread per client", error);
+        return false;
+    }
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        LOG_WARN("[SERVER] eventfd failed ({}), using a thread per client", std::strerror(errno));
+        return false;
+    }
+    
+    int cpu = options.client_cpus.empty() ? options.accept_cpu : options.client_cpus[0];
+    if (cpu >= 0 && !pinCurrentThread(cpu)) {
+        LOG_WARN("[SERVER] Could not pin the io_uring reactor to CPU {}", cpu);
+    }
+    LOG_INFO("[SERVER] Serving clients from one io_uring reactor ({} provided buffers)",
+             ring.mappedBuffers() ? "ring-mapped" : "legacy");
+    
+    uint64_t wake_value = 0;
+    
+    auto nextSqe = [&ring]() {
+        io_uring_sqe* sqe;
+        while ((sqe = ring.getSqe()) == nullptr) {
+            ring.submitAndWait(0);
+        }
+        return sqe;
+    };
+    
+    auto armAccept = [&]() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = server_socket;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = userData(OP_ACCEPT, 0);
+    };
+    
+    auto armRecv = [&](UringConnection& conn) {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = conn.session->socket;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_GROUP;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = userData(OP_RECV, conn.session->session_id);
+        conn.receiving = true;
+    };
+    
+    // Idle checks tick with a timeout on the ring, so they need no thread
+    auto tick_ns = std::chrono::nanoseconds(idle_timers.tickLength()).count();
+    __kernel_timespec tick{};
+    tick.tv_sec = tick_ns / 1000000000;
+    tick.tv_nsec = tick_ns % 1000000000;
+    auto armTimer = [&]() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = reinterpret_cast<uint64_t>(&tick);
+        sqe->len = 1;
+        sqe->user_data = userData(OP_TIMER, 0);
+    };
+    
+    auto armWake = [&]() {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = wake_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&wake_value);
+        sqe->len = sizeof(wake_value);
+        sqe->user_data = userData(OP_WAKE, 0);
+    };
+    
+    // Stops input; the recv completes with -ECANCELED and no F_MORE
+    auto stopReceiving = [&](UringConnection& conn) {
+        conn.closing = true;
+        if (conn.receiving) {
+            io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = userData(OP_RECV, conn.session->session_id);
+            sqe->user_data = userData(OP_CANCEL, conn.session->session_id);
+        }
+    };
+    
+    // Writes queued output as one linked chain; only one chain is in flight
+    // per connection so messages keep their order
+    auto flush = [&](UringConnection& conn) {
+        Session& session = *conn.session;
+        if (!conn.in_flight.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(session.send_mutex);
+            // Small messages share a send; each send costs a pass through
+            // the TCP stack regardless of size
+            while (!session.outbox.empty()) {
+                std::string& message = session.outbox.front();
+                if (!conn.in_flight.empty() && conn.in_flight.back().size() + message.size() <= SEND_COALESCE_BYTES) {
+                    conn.in_flight.back() += message;
+                } else if (conn.in_flight.size() < MAX_SEND_CHAIN) {
+                    conn.in_flight.push_back(std::move(message));
+                } else {
+                    break;
+                }
+                session.outbox.pop_front();
+            }
+        }
+        if (conn.in_flight.empty()) {
+            return;
+        }
+        
+        // A chain split across two submits would lose its ordering
+        if (ring.sqSpace() < conn.in_flight.size()) {
+            ring.submitAndWait(0);
+        }
+        conn.results.assign(conn.in_flight.size(), 0);
+        conn.completions = 0;
+        for (size_t i = 0; i < conn.in_flight.size(); ++i) {
+            io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = session.socket;
+            sqe->addr = reinterpret_cast<uint64_t>(conn.in_flight[i].data());
+            sqe->len = static_cast<uint32_t>(conn.in_flight[i].size());
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+            sqe->flags = i + 1 < conn.in_flight.size() ? IOSQE_IO_LINK : 0;
+            sqe->user_data = userData(OP_SEND, session.session_id, static_cast<unsigned>(i));
+        }
+    };
+    
+    // Closes the connection once input has stopped and output has drained
+    auto finishIfDone = [&](UringConnection& conn) {
+        if (!conn.closing || conn.receiving || !conn.in_flight.empty()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(conn.session->send_mutex);
+            if (!conn.session->outbox.empty()) {
+                return false;
+            }
+        }
+        int session_id = conn.session->session_id;
+        closeSession(*conn.session);
+        connections.erase(session_id);
+        return true;
+    };
+    
+    // Puts back whatever a finished chain did not write, ahead of newer output
+    auto onChainDone = [&](UringConnection& conn) {
+        std::vector<std::string> unsent;
+        bool failed = false;
+        for (size_t i = 0; i < conn.in_flight.size(); ++i) {
+            int result = conn.results[i];
+            if (result > 0) {
+                metrics.bytes_out.add(result);
+            }
+            if (result >= 0 && static_cast<size_t>(result) == conn.in_flight[i].size()) {
+                continue;
+            }
+            if (result > 0) {
+                unsent.push_back(conn.in_flight[i].substr(result));
+            } else if (result == -ECANCELED || result == -EINTR || result == -EAGAIN) {
+                unsent.push_back(std::move(conn.in_flight[i]));
+            } else {
+                failed = true;
+                break;
+            }
+        }
+        conn.in_flight.clear();
+        
+        {
+            std::lock_guard<std::mutex> lock(conn.session->send_mutex);
+            if (failed) {
+                conn.session->outbox.clear();
+            } else {
+                conn.session->outbox.insert(conn.session->outbox.begin(),
+                                            std::make_move_iterator(unsent.begin()),
+                                            std::make_move_iterator(unsent.end()));
+            }
+        }
+        if (failed && !conn.closing) {
+            LOG_INFO("[SERVER] Client disconnected");
+            stopReceiving(conn);
+        }
+        if (!finishIfDone(conn)) {
+            flush(conn);
+        }
+    };
+    
+    auto onAccept = [&](const io_uring_cqe& cqe) {
+        if (cqe.res < 0) {
+            if (running) {
+                LOG_ERROR("[SERVER] Failed to accept client");
+            }
+            return;
+        }
+        int client_socket = cqe.res;
+        
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        char client_ip[INET_ADDRSTRLEN] = "unknown";
+        if (getpeername(client_socket, (struct sockaddr*)&client_addr, &client_len) == 0) {
+            inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+        }
+        LOG_INFO("[SERVER] Client connected from {}", client_ip);
+        
+        configureClientSocket(client_socket);
+        
+        auto session = std::make_shared<Session>(next_session_id++, client_socket);
+        session->rate_limit.configure(options.session_rate, options.session_burst);
+        session->last_input = std::chrono::steady_clock::now().time_since_epoch().count();
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            sessions[session->session_id] = session;
+        }
+        metrics.connections.add();
+        metrics.active_connections.add(1);
+        if (idleChecksEnabled()) {
+            watchIdle(session->session_id, std::chrono::steady_clock::now());
+        }
+        
+        UringConnection& conn = connections[session->session_id];
+        conn.session = session;
+        armRecv(conn);
+    };
+    
+    auto onRecv = [&](UringConnection& conn, const io_uring_cqe& cqe) {
+        bool more = cqe.flags & IORING_CQE_F_MORE;
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (cqe.res > 0 && !conn.closing) {
+                metrics.bytes_in.add(cqe.res);
+                conn.session->last_input.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                               std::memory_order_relaxed);
+                conn.session->pending.append(ring.bufferData(buffer_id), cqe.res);
+            }
+            ring.recycleBuffer(buffer_id);
+        }
+        
+        if (cqe.res > 0 && !conn.closing && !processInput(*conn.session)) {
+            stopReceiving(conn);
+        }
+        if (more) {
+            return;
+        }
+        
+        // Out of provided buffers or a stopped multishot: re-arm; anything
+        // else ends the connection
+        conn.receiving = false;
+        if (!conn.closing && (cqe.res > 0 || cqe.res == -ENOBUFS)) {
+            armRecv(conn);
+            return;
+        }
+        if (!conn.closing) {
+            LOG_INFO("[SERVER] Client disconnected");
+            conn.closing = true;
+        }
+        finishIfDone(conn);
+    };
+    
+    reactor_thread = std::this_thread::get_id();
+    uring_active = true;
+    armAccept();
+    armWake();
+    if (idleChecksEnabled()) {
+        armTimer();
+    }
     
     while (running) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+        uint64_t calls_before = ring.enterCalls();
+        int result = ring.submitAndWait(options.spin ? 0 : 1);
+        if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+            LOG_ERROR("[SERVER] io_uring_enter failed: {}", std::strerror(-result));
+            break;
+        }
+        
+        unsigned completed = ring.forEachCompletion([&](const io_uring_cqe& cqe) {
+            UringOp op = static_cast<UringOp>(cqe.user_data >> 56);
+            int session_id = static_cast<int>(cqe.user_data & 0xffffffff);
+            
+            if (op == OP_ACCEPT) {
+                onAccept(cqe);
+                if (!(cqe.flags & IORING_CQE_F_MORE) && running && cqe.res != -EBADF && cqe.res != -EINVAL) {
+                    armAccept();
+                }
+                return;
+            }
+            if (op == OP_WAKE) {
+                if (running) {
+                    armWake();
+                }
+                return;
+            }
+            if (op == OP_TIMER) {
+                expireIdleTimers();
+                if (running) {
+                    armTimer();
+                }
+                return;
+            }
+            
+            auto it = connections.find(session_id);
+            if (it == connections.end()) {
+                // Buffers picked by a receive that outlived its connection
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    ring.recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+                return;
+            }
+            UringConnection& conn = it->second;
+            
+            if (op == OP_RECV) {
+                onRecv(conn, cqe);
+            } else if (op == OP_SEND) {
+                conn.results[(cqe.user_data >> 32) & 0xffff] = cqe.res;
+                if (++conn.completions == conn.in_flight.size()) {
+                    onChainDone(conn);
+                }
+            }
+        });
         
+        // Output queued by this batch (or woken in from other threads) goes
+        // out with the next submit
+        std::vector<int> ready;
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready.swap(ready_sessions);
+        }
+        for (int session_id : ready) {
+            auto it = connections.find(session_id);
+            if (it != connections.end()) {
+                flush(it->second);
+            }
+        }
+        
+        metrics.io_syscalls.add(ring.enterCalls() - calls_before);
+        if (options.spin && completed == 0) {
+            cpuRelax();
+        }
+    }
+    
+    uring_active = false;
+    for (auto& [id, conn] : connections) {
+        closeSession(*conn.session);
+    }
+    close(wake_fd);
+    wake_fd = -1;
+    return true;
+}
+
+void NetworkServer::wakeReactor() {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN("[SERVER] Could not wake the io_uring reactor: {}", std::strerror(errno));
+    }
+}
+
+void NetworkServer::handleClient(std::shared_ptr<Session> session_ptr) {
+    Session& session = *session_ptr;
+    int client_socket = session.socket;
+    char buffer[4096];
+    bool disconnect = false;
+    
+    if (!options.client_cpus.empty()) {
+        int cpu = options.client_cpus[(session.session_id - 1) % options.client_cpus.size()];
+        if (!pinCurrentThread(cpu)) {
+            LOG_WARN("[SERVER] Could not pin session {} to CPU {}", session.session_id, cpu);
+        }
+    }
+    
+    // Touch the session buffers only after pinning, so their pages come from
+    // this thread's node
+    session.pending.reserve(sizeof(buffer));
+    session.output.reserve(sizeof(buffer));
+    
+    // Spinning keeps the thread on its core with the socket hot instead of
+    // sleeping in recv and paying a wakeup per message
+    int recv_flags = options.spin ? MSG_DONTWAIT : 0;
+    
+    while (running && !disconnect) {
+        ssize_t bytes_read = recv(client_socket, buffer, sizeof(buffer), recv_flags);
+        metrics.io_syscalls.add();
+        
+        if (bytes_read < 0 && options.spin && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            cpuRelax();
+            continue;
+        }
         if (bytes_read <= 0) {
-            std::cout << "[SERVER] Client disconnected" << std::endl;
+            LOG_INFO("[SERVER] Client disconnected");
             break;
         }
+        metrics.bytes_in.add(bytes_read);
+        session.last_input.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                 std::memory_order_relaxed);
+        session.pending.append(buffer, bytes_read);
+        disconnect = !processInput(session);
+    }
+    
+    closeSession(session);
+}
+
+bool NetworkServer::processInput(Session& session) {
+    std::string& pending = session.pending;
+    bool disconnect = false;
+    
+    if (session.skip_line) {
+        size_t end = pending.find('\n');
+        if (end == std::string::npos) {
+            pending.clear();
+            return true;
+        }
+        pending.erase(0, end + 1);
+        session.skip_line = false;
+    }
+    
+    // Commands are newline-terminated and may arrive split or coalesced
+    size_t start = 0;
+    size_t newline;
+    while ((newline = pending.find('\n', start)) != std::string::npos) {
+        std::string_view command(pending.data() + start, newline - start + 1);
+        start = newline + 1;
         
-        std::string command(buffer);
-        std::cout << "[SERVER] Received: " << command;
+        LOG_DEBUG("[SERVER] Received: {}", command);
         
-        std::string response = processCommand(command);
+        // Optional "#<id> " correlation tag switches the session to framed responses
+        bool tagged = false;
+        uint64_t correlation_id = 0;
+        if (command[0] == '#') {
+            size_t space = command.find(' ');
+            if (!CommandParser::parse(command.substr(1, space - 1), correlation_id)) {
+                correlation_id = 0;
+            }
+            command.remove_prefix(space == std::string_view::npos ? command.size() : space + 1);
+            tagged = true;
+            session.framed = true;
+        }
+        
+        // Depth is sent from the book's shared rendering rather than a copy
+        std::shared_ptr<const std::string> snapshot;
+        std::string response;
+        if (!admitCommand(session, command)) {
+            metrics.throttled.add();
+            response = "ERROR: Throttled: command rate limit exceeded\n";
+        } else {
+            CommandParser parser(command);
+            std::string_view cmd = parser.next();
+            std::string symbol;
+            AdmissionQueue::Lane lane;
+            if (cmd == "SHOW_ORDERS" && parser.read(symbol)) {
+                snapshot = engine->orderSnapshot(symbol);
+            }
+            if (!snapshot) {
+                if (!engineLane(cmd, lane)) {
+                    response = processCommand(command, session);
+                } else if (enterEngine(lane)) {
+                    response = processCommand(command, session);
+                    admission.leave();
+                } else {
+                    response = "ERROR: Server busy: order queue full\n";
+                }
+            }
+        }
+        const std::string& payload = snapshot ? *snapshot : response;
+        metrics.commands.add();
         
         // Send response
-        send(client_socket, response.c_str(), response.length(), 0);
+        if (tagged) {
+            std::string& output = session.output;
+            output.clear();
+            appendFrameHeader(output, correlation_id, payload.size());
+            output += payload;
+            sendAll(session, output);
+        } else {
+            sendAll(session, payload);
+        }
         
         // Check for disconnect command
-        if (command.find("DISCONNECT") == 0) {
+        if (command.substr(0, 10) == "DISCONNECT") {
+            disconnect = true;
             break;
         }
     }
+    pending.erase(0, start);
+    
+    if (pending.size() > MAX_COMMAND_LENGTH) {
+        // No request to answer, so framed clients get it as a push
+        const std::string error = "ERROR: Command too long\n";
+        sendAll(session, session.framed ? frame(0, error) : error);
+        pending.clear();
+        session.skip_line = true;
+    }
+    return !disconnect;
+}
+
+bool NetworkServer::admitCommand(Session& session, std::string_view command) {
+    // Pulling an order must work for a client that is over its limit. Only
+    // CANCEL itself: CANCEL_ALL can walk every book and is charged as usual.
+    if (CommandParser(command).next() == "CANCEL") {
+        return true;
+    }
+    if (!session.rate_limit.tryConsume()) {
+        return false;
+    }
+    // Sessions that never LOGON share the default account, so only their
+    // connection limit applies
+    return !account_limits || session.account_id == RiskManager::DEFAULT_ACCOUNT ||
+           account_limits[session.account_id].tryConsume();
+}
+
+bool NetworkServer::enterEngine(AdmissionQueue::Lane lane) {
+    return options.use_uring ? admission.tryEnter(lane) : admission.enter(lane);
+}
+
+void NetworkServer::attachGateway(ShmGateway* gw) {
+    gateway = gw;
+    
+    ShmGateway::Limits limits;
+    limits.admission = &admission;
+    limits.account_limits = account_limits.get();
+    limits.throttled = &metrics.throttled;
+    limits.client_rate = options.session_rate;
+    limits.client_burst = options.session_burst;
+    gateway->setLimits(limits);
+}
+
+void NetworkServer::closeSession(Session& session) {
+    if (session.cancel_on_disconnect) {
+        enterEngine(AdmissionQueue::CANCEL);
+        int cancelled = engine->cancelAll(session.session_id);
+        admission.leave();
+        LOG_INFO("[SERVER] Cancelled {} orders for session {} on disconnect", cancelled, session.session_id);
+    }
     
-    // Clean up
-    close(client_socket);
+    unsubscribeAll(session.session_id);
     
     {
         std::lock_guard<std::mutex> lock(clients_mutex);
-        client_sockets.erase(
-            std::remove(client_sockets.begin(), client_sockets.end(), client_socket),
-            client_sockets.end()
-        );
+        sessions.erase(session.session_id);
+    }
+    
+    {
+        // Wait out any push still writing to this socket
+        std::lock_guard<std::mutex> lock(session.send_mutex);
+        close(session.socket);
+        session.socket = -1;
+        session.outbox.clear();
     }
+    metrics.active_connections.add(-1);
 }
 
-std::string NetworkServer::processCommand(const std::string& command) {
-    std::istringstream iss(command);
-    std::string cmd;
-    iss >> cmd;
+void NetworkServer::watchIdle(int session_id, TimerWheel<int>::Clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(timers_mutex);
+    idle_timers.schedule(session_id, deadline);
+}
+
+void NetworkServer::expireIdleTimers() {
+    auto now = TimerWheel<int>::Clock::now();
+    std::vector<int> due;
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex);
+        idle_timers.advance(now, [&due](int session_id) { due.push_back(session_id); });
+    }
+    for (int session_id : due) {
+        checkIdle(session_id, now);
+    }
+}
+
+void NetworkServer::checkIdle(int session_id, TimerWheel<int>::Clock::time_point now) {
+    using Clock = TimerWheel<int>::Clock;
+    auto heartbeat = std::chrono::milliseconds(options.heartbeat_ms);
+    auto timeout = std::chrono::milliseconds(options.idle_timeout_ms);
     
-    if (cmd == "ADD_ORDER") {
-        std::string side_str, symbol;
+    std::shared_ptr<Session> session;
+    Clock::time_point last_input;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = sessions.find(session_id);
+        if (it == sessions.end()) {
+            return;  // Closed; its timer just lapses
+        }
+        session = it->second;
+        last_input = Clock::time_point(Clock::duration(session->last_input.load(std::memory_order_relaxed)));
+        
+        if (now - last_input >= timeout) {
+            // Registered sessions still own their socket; the reader sees end
+            // of input and closes the session as for any disconnect
+            LOG_INFO("[SERVER] Session {} idle for {}ms, disconnecting", session_id, options.idle_timeout_ms);
+            shutdown(session->socket, SHUT_RDWR);
+            metrics.idle_disconnects.add();
+            return;
+        }
+    }
+    
+    if (options.heartbeat_ms > 0 && now - last_input >= heartbeat && session->framed) {
+        sendHeartbeat(*session);
+    }
+    
+    // Heartbeats repeat while the session stays silent
+    auto interval = options.heartbeat_ms > 0 ? heartbeat : timeout;
+    auto next = now - last_input < interval ? last_input + interval : now + interval;
+    watchIdle(session_id, std::min(next, last_input + timeout));
+}
+
+void NetworkServer::sendHeartbeat(Session& session) {
+    static const std::string message = frame(0, "HEARTBEAT\n");
+    metrics.heartbeats.add();
+    if (uring_active) {
+        sendAll(session, message);
+        return;
+    }
+    
+    // A blocking send to a peer that stopped reading would hold up every
+    // other check, so skip the beat while a writer has the socket and drop a
+    // peer whose buffer cannot take it
+    std::unique_lock<std::mutex> lock(session.send_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || session.socket < 0) {
+        return;
+    }
+    ssize_t sent = send(session.socket, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    metrics.io_syscalls.add();
+    if (sent > 0) {
+        metrics.bytes_out.add(sent);
+    }
+    if (sent != static_cast<ssize_t>(message.size())) {
+        shutdown(session.socket, SHUT_RDWR);
+    }
+}
+
+// Runs the idle checks for the thread-per-client backend
+void NetworkServer::superviseSessions() {
+    std::unique_lock<std::mutex> lock(timers_mutex);
+    while (running) {
+        supervisor_wake.wait_for(lock, idle_timers.tickLength());
+        lock.unlock();
+        expireIdleTimers();
+        lock.lock();
+    }
+}
+
+bool NetworkServer::sendAll(Session& session, const std::string& data) {
+    if (uring_active) {
+        // The reactor writes it; report success once queued, as a blocking
+        // send reports it once the kernel has the bytes
+        {
+            std::lock_guard<std::mutex> lock(session.send_mutex);
+            if (session.socket < 0) {
+                return false;
+            }
+            session.outbox.push_back(data);
+        }
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready_sessions.push_back(session.session_id);
+        }
+        if (std::this_thread::get_id() != reactor_thread) {
+            wakeReactor();
+        }
+        return true;
+    }
+    
+    std::lock_guard<std::mutex> lock(session.send_mutex);
+    
+    size_t offset = 0;
+    while (offset < data.size()) {
+        if (session.socket < 0) {
+            return false;
+        }
+        ssize_t sent = send(session.socket, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        metrics.io_syscalls.add();
+        if (sent <= 0) {
+            return false;
+        }
+        offset += sent;
+        metrics.bytes_out.add(sent);
+    }
+    return true;
+}
+
+void NetworkServer::pushToSession(int session_id, const std::string& message) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto it = sessions.find(session_id);
+        if (it == sessions.end()) {
+            return;
+        }
+        session = it->second;
+    }
+    
+    // Untagged clients read one response per request, so never push to them
+    if (session->framed) {
+        sendAll(*session, frame(0, message));
+    }
+}
+
+void NetworkServer::onFill(const Fill& fill) {
+    if (risk) {
+        risk->onFill(fill);
+    }
+    if (fill.session_id == 0) {
+        return;
+    }
+    if (gateway && gateway->ownsSession(fill.session_id)) {
+        gateway->onFill(fill);
+        return;
+    }
+    
+    std::stringstream msg;
+    msg << "FILL " << fill.order_id << " " << (fill.side == OrderSide::BUY ? "BUY" : "SELL") << " "
+        << fill.quantity << " " << fill.symbol << " @ $" << std::fixed << std::setprecision(2)
+        << fill.price << " REMAINING " << fill.remaining << "\n";
+    pushToSession(fill.session_id, msg.str());
+}
+
+void NetworkServer::onCancel(const OrderCancel& cancel) {
+    if (risk) {
+        risk->onCancel(cancel);
+    }
+    if (cancel.session_id == 0) {
+        return;
+    }
+    if (gateway && gateway->ownsSession(cancel.session_id)) {
+        gateway->onCancel(cancel);
+        return;
+    }
+    
+    std::stringstream msg;
+    msg << "CANCELED " << cancel.order_id << " " << (cancel.side == OrderSide::BUY ? "BUY" : "SELL") << " "
+        << cancel.quantity << " " << cancel.symbol << " REMAINING " << cancel.remaining << "\n";
+    pushToSession(cancel.session_id, msg.str());
+}
+
+void NetworkServer::onQuote(const Quote& quote) {
+    if (risk && quote.spread.empty()) {
+        risk->onQuote(quote);
+    }
+    
+    std::vector<int> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        auto it = subscriptions.find(quote.symbol);
+        if (it == subscriptions.end()) {
+            return;
+        }
+        subscribers.assign(it->second.begin(), it->second.end());
+    }
+    
+    std::string message = formatQuote(quote);
+    for (int session_id : subscribers) {
+        pushToSession(session_id, message);
+    }
+}
+
+void NetworkServer::unsubscribeAll(int session_id) {
+    std::lock_guard<std::mutex> lock(subscriptions_mutex);
+    for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+        it->second.erase(session_id);
+        if (it->second.empty()) {
+            it = subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::string NetworkServer::processCommand(std::string_view command, Session& session) {
+    CommandParser parser(command);
+    std::string_view cmd = parser.next();
+    
+    if (cmd == "ADD_ORDER" || cmd == "FOK") {
+        std::string_view side_str;
+        std::string symbol;
         double price;
         int quantity;
         
-        if (!(iss >> side_str >> symbol >> price >> quantity)) {
-            return "ERROR: Invalid command format\nUsage: ADD_ORDER <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>\n";
+        if (!parser.read(side_str, symbol, price, quantity)) {
+            return "ERROR: Invalid command format\nUsage: " + std::string(cmd) + " <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>\n";
         }
         
         OrderSide side;
-        if (side_str == "BUY") {
-            side = OrderSide::BUY;
-        } else if (side_str == "SELL") {
-            side = OrderSide::SELL;
-        } else {
+        if (!parseSide(side_str, side)) {
             return "ERROR: Invalid side. Use BUY or SELL\n";
         }
         
-        if (price <= 0 || quantity <= 0) {
+        if ((price <= 0 && !engine->isSpread(symbol)) || quantity <= 0) {
             return "ERROR: Price and quantity must be positive\n";
         }
         
-        std::string result = engine->addOrder(symbol, side, price, quantity);
+        if (risk) {
+            std::string reject = risk->checkNewOrder(session.account_id, symbol, side, price, quantity);
+            if (!reject.empty()) {
+                return reject;
+            }
+        }
+        
+        session.has_orders = true;
+        if (cmd == "FOK") {
+            return engine->addFillOrKillOrder(symbol, side, price, quantity,
+                                              session.session_id, session.account_id, session.stp_mode);
+        }
+        std::string result = engine->addOrder(symbol, side, price, quantity,
+                                              session.session_id, session.account_id, session.stp_mode);
         return result;
     }
+    else if (cmd == "ICEBERG") {
+        std::string_view side_str;
+        std::string symbol;
+        double price;
+        int quantity, display_quantity;
+        
+        if (!parser.read(side_str, symbol, price, quantity, display_quantity)) {
+            return "ERROR: Invalid command format\n"
+                   "Usage: ICEBERG <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY> <DISPLAY_QUANTITY>\n";
+        }
+        
+        OrderSide side;
+        if (!parseSide(side_str, side)) {
+            return "ERROR: Invalid side. Use BUY or SELL\n";
+        }
+        
+        if ((price <= 0 && !engine->isSpread(symbol)) || quantity <= 0 || display_quantity <= 0) {
+            return "ERROR: Price and quantity must be positive\n";
+        }
+        
+        if (risk) {
+            std::string reject = risk->checkNewOrder(session.account_id, symbol, side, price, quantity);
+            if (!reject.empty()) {
+                return reject;
+            }
+        }
+        
+        session.has_orders = true;
+        return engine->addIcebergOrder(symbol, side, price, quantity, display_quantity,
+                                       session.session_id, session.account_id, session.stp_mode);
+    }
+    else if (cmd == "STOP" || cmd == "STOP_LIMIT") {
+        std::string_view side_str;
+        std::string symbol;
+        double stop_price;
+        double limit_price = 0.0;
+        int quantity;
+        
+        bool parsed = cmd == "STOP" ? parser.read(side_str, symbol, stop_price, quantity)
+                                    : parser.read(side_str, symbol, stop_price, limit_price, quantity);
+        if (!parsed) {
+            return cmd == "STOP"
+                ? "ERROR: Invalid command format\nUsage: STOP <BUY|SELL> <SYMBOL> <STOP_PRICE> <QUANTITY>\n"
+                : "ERROR: Invalid command format\nUsage: STOP_LIMIT <BUY|SELL> <SYMBOL> <STOP_PRICE> <LIMIT_PRICE> <QUANTITY>\n";
+        }
+        
+        OrderSide side;
+        if (!parseSide(side_str, side)) {
+            return "ERROR: Invalid side. Use BUY or SELL\n";
+        }
+        
+        if (stop_price <= 0 || quantity <= 0 || (cmd == "STOP_LIMIT" && limit_price <= 0)) {
+            return "ERROR: Price and quantity must be positive\n";
+        }
+        
+        // A stop-market order is checked at its trigger price
+        if (risk) {
+            std::string reject = risk->checkNewOrder(session.account_id, symbol, side,
+                                                     limit_price > 0 ? limit_price : stop_price, quantity);
+            if (!reject.empty()) {
+                return reject;
+            }
+        }
+        
+        session.has_orders = true;
+        return engine->addStopOrder(symbol, side, stop_price, limit_price, quantity,
+                                    session.session_id, session.account_id, session.stp_mode);
+    }
+    else if (cmd == "BATCH") {
+        // BATCH ADD <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>; REPLACE <SYMBOL> <ORDER_ID> <PRICE> <QUANTITY>; ...
+        std::string_view rest = parser.remainder();
+        
+        std::vector<BatchEntry> entries;
+        
+        while (!rest.empty()) {
+            size_t end = rest.find(';');
+            CommandParser entry_parser(rest.substr(0, end));
+            rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+            
+            std::string_view type = entry_parser.next();
+            if (type.empty()) {
+                continue;  // Allow a trailing ';'
+            }
+            
+            BatchEntry entry;
+            std::string entry_error = "ERROR: Invalid batch entry " + std::to_string(entries.size() + 1) + "\n";
+            
+            if (type == "ADD") {
+                std::string_view side_str;
+                entry.type = BatchEntry::Type::ADD;
+                entry.order_id = 0;
+                if (!entry_parser.read(side_str, entry.symbol, entry.price, entry.quantity) ||
+                    !parseSide(side_str, entry.side)) {
+                    return entry_error;
+                }
+            } else if (type == "REPLACE") {
+                entry.type = BatchEntry::Type::REPLACE;
+                entry.side = OrderSide::BUY;  // Taken from the resting order
+                if (!entry_parser.read(entry.symbol, entry.order_id, entry.price, entry.quantity)) {
+                    return entry_error;
+                }
+            } else {
+                return entry_error;
+            }
+            
+            if ((entry.price <= 0 && !engine->isSpread(entry.symbol)) || entry.quantity <= 0) {
+                return "ERROR: Price and quantity must be positive\n";
+            }
+            
+            entries.push_back(entry);
+        }
+        
+        if (entries.empty()) {
+            return "ERROR: Invalid command format\nUsage: BATCH ADD <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>; "
+                   "REPLACE <SYMBOL> <ORDER_ID> <PRICE> <QUANTITY>; ...\n";
+        }
+        if (entries.size() > MAX_BATCH_ENTRIES) {
+            return "ERROR: Too many batch entries (max " + std::to_string(MAX_BATCH_ENTRIES) + ")\n";
+        }
+        
+        // All-or-nothing: on a reject, give back the open-order slots already taken
+        if (risk) {
+            int passed = 0;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const BatchEntry& entry = entries[i];
+                std::string reject = entry.type == BatchEntry::Type::ADD
+                    ? risk->checkNewOrder(session.account_id, entry.symbol, entry.side, entry.price, entry.quantity)
+                    : risk->checkReplace(session.account_id, entry.symbol, entry.price, entry.quantity);
+                
+                if (!reject.empty()) {
+                    risk->releaseOpenOrders(session.account_id, passed);
+                    return "ERROR: Batch entry " + std::to_string(i + 1) + " rejected\n" + reject;
+                }
+                if (entry.type == BatchEntry::Type::ADD) {
+                    ++passed;
+                }
+            }
+        }
+        
+        session.has_orders = true;
+        return engine->addBatch(std::move(entries), session.session_id, session.account_id, session.stp_mode);
+    }
+    else if (cmd == "CANCEL") {
+        std::string symbol;
+        int order_id;
+        if (!parser.read(symbol, order_id)) {
+            return "ERROR: Invalid command format\nUsage: CANCEL <SYMBOL> <ORDER_ID>\n";
+        }
+        
+        return engine->cancelOrder(symbol, order_id, session.session_id);
+    }
+    else if (cmd == "CANCEL_ALL") {
+        // CANCEL_ALL [SYMBOL|*] [BUY|SELL]
+        std::string symbol(parser.next());
+        std::string_view side_str = parser.next();
+        if (symbol == "*") {
+            symbol.clear();
+        }
+        
+        std::optional<OrderSide> side;
+        if (!side_str.empty()) {
+            OrderSide parsed;
+            if (!parseSide(side_str, parsed)) {
+                return "ERROR: Invalid side. Use BUY or SELL\n";
+            }
+            side = parsed;
+        }
+        
+        int cancelled = engine->cancelAll(session.session_id, symbol, side);
+        return "OK: Cancelled " + std::to_string(cancelled) + " orders\n";
+    }
+    else if (cmd == "DENSE_BOOK") {
+        std::string symbol;
+        double tick_size;
+        if (!parser.read(symbol, tick_size)) {
+            return "ERROR: Invalid command format\nUsage: DENSE_BOOK <SYMBOL> <TICK_SIZE>\n";
+        }
+        if (!engine->setBookType(symbol, BookType::LADDER, tick_size)) {
+            return "ERROR: " + symbol + " already has a book or the tick size is not positive\n";
+        }
+        return "OK: " + symbol + " uses a dense book\n";
+    }
+    else if (cmd == "SPREAD") {
+        std::string symbol, buy_leg, sell_leg;
+        if (!parser.read(symbol, buy_leg, sell_leg)) {
+            return "ERROR: Invalid command format\nUsage: SPREAD <SYMBOL> <BUY_LEG> <SELL_LEG>\n";
+        }
+        std::string result = engine->defineSpread(symbol, buy_leg, sell_leg);
+        if (risk && result.compare(0, 3, "OK:") == 0) {
+            risk->markSpread(symbol);
+        }
+        return result;
+    }
+    else if (cmd == "AUCTION_START" || cmd == "AUCTION_UNCROSS") {
+        std::string symbol;
+        if (!parser.read(symbol)) {
+            return "ERROR: Invalid command format\nUsage: " + std::string(cmd) + " <SYMBOL>\n";
+        }
+        return cmd == "AUCTION_START" ? engine->startAuction(symbol) : engine->uncrossAuction(symbol);
+    }
+    else if (cmd == "LOGON") {
+        std::string account;
+        if (!parser.read(account)) {
+            return "ERROR: Invalid command format\nUsage: LOGON <ACCOUNT>\n";
+        }
+        if (!risk) {
+            return "ERROR: Accounts are not enabled on this server\n";
+        }
+        if (session.has_orders) {
+            return "ERROR: LOGON must come before the first order\n";
+        }
+        
+        int account_id = risk->registerAccount(account);
+        if (account_id < 0) {
+            return "ERROR: Account limit reached\n";
+        }
+        session.account_id = account_id;
+        return "OK: Logged on as " + account + "\n";
+    }
+    else if (cmd == "CANCEL_ON_DISCONNECT") {
+        std::string_view mode = parser.next();
+        if (mode == "ON") {
+            session.cancel_on_disconnect = true;
+        } else if (mode == "OFF") {
+            session.cancel_on_disconnect = false;
+        } else {
+            return "ERROR: Invalid command format\nUsage: CANCEL_ON_DISCONNECT <ON|OFF>\n";
+        }
+        return "OK: Cancel on disconnect " + std::string(mode) + "\n";
+    }
+    else if (cmd == "STP") {
+        static const std::pair<const char*, StpMode> modes[] = {
+            {"NONE", StpMode::NONE},
+            {"CANCEL_NEWEST", StpMode::CANCEL_NEWEST},
+            {"CANCEL_OLDEST", StpMode::CANCEL_OLDEST},
+            {"CANCEL_BOTH", StpMode::CANCEL_BOTH},
+            {"DECREMENT", StpMode::DECREMENT},
+        };
+        
+        std::string_view mode = parser.next();
+        for (const auto& [name, value] : modes) {
+            if (mode == name) {
+                session.stp_mode = value;
+                return "OK: STP " + std::string(mode) + "\n";
+            }
+        }
+        return "ERROR: Invalid command format\nUsage: STP <NONE|CANCEL_NEWEST|CANCEL_OLDEST|CANCEL_BOTH|DECREMENT>\n";
+    }
+    else if (cmd == "SUBSCRIBE" || cmd == "UNSUBSCRIBE") {
+        std::string symbol;
+        if (!parser.read(symbol)) {
+            return "ERROR: Invalid command format\nUsage: " + std::string(cmd) + " <SYMBOL>\n";
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            if (cmd == "SUBSCRIBE") {
+                subscriptions[symbol].insert(session.session_id);
+            } else {
+                subscriptions[symbol].erase(session.session_id);
+            }
+        }
+        
+        // Start subscribers off with the current top of book
+        Quote quote;
+        quote.symbol = symbol;
+        if (auto current = engine->getQuote(symbol)) {
+            quote = *current;
+        }
+        return "OK: " + std::string(cmd) + " " + symbol + "\n" + (cmd == "SUBSCRIBE" ? formatQuote(quote) : "");
+    }
     else if (cmd == "SHOW_ORDERS") {
         std::string symbol;
-        if (!(iss >> symbol)) {
+        if (!parser.read(symbol)) {
             return "ERROR: Invalid command format\nUsage: SHOW_ORDERS <SYMBOL>\n";
         }
         
         return engine->showOrders(symbol);
     }
+    else if (cmd == "SHOW_BBO") {
+        // SHOW_BBO <SYMBOL> [SYMBOL...] or SHOW_BBO * for every book; one
+        // QUOTE line per symbol, read without locking the books
+        std::vector<std::string> symbols;
+        for (std::string_view symbol = parser.next(); !symbol.empty(); symbol = parser.next()) {
+            symbols.emplace_back(symbol);
+        }
+        if (symbols.empty()) {
+            return "ERROR: Invalid command format\nUsage: SHOW_BBO <SYMBOL> [SYMBOL...] | SHOW_BBO *\n";
+        }
+        if (symbols.size() == 1 && symbols[0] == "*") {
+            symbols.clear();
+        }
+        
+        std::string response;
+        for (const Quote& quote : engine->getQuotes(symbols)) {
+            response += formatQuote(quote);
+        }
+        return response.empty() ? "OK: No order books\n" : response;
+    }
+    else if (cmd == "HEARTBEAT") {
+        // Any input keeps a session alive; this one exists to answer a
+        // HEARTBEAT push or to keep an otherwise quiet session open
+        return "OK: HEARTBEAT\n";
+    }
     else if (cmd == "DISCONNECT") {
         return "OK: Goodbye!\n";
     }
     else {
-        return "ERROR: Unknown command\nAvailable commands: ADD_ORDER, SHOW_ORDERS, DISCONNECT\n";
+        return "ERROR: Unknown command\nAvailable commands: LOGON, ADD_ORDER, FOK, ICEBERG, STOP, STOP_LIMIT, BATCH, CANCEL, CANCEL_ALL, "
+               "CANCEL_ON_DISCONNECT, STP, DENSE_BOOK, SPREAD, AUCTION_START, AUCTION_UNCROSS, "
+               "SUBSCRIBE, UNSUBSCRIBE, SHOW_ORDERS, SHOW_BBO, HEARTBEAT, DISCONNECT\n";
     }
 }
 
 void NetworkServer::broadcastMessage(const std::string& message) {
-    std::lock_guard<std::mutex> lock(clients_mutex);
+    std::vector<std::shared_ptr<Session>> targets;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (auto& [id, session] : sessions) {
+            targets.push_back(session);
+        }
+    }
     
-    for (int socket : client_sockets) {
-        send(socket, message.c_str(), message.length(), 0);
+    for (auto& session : targets) {
+        sendAll(*session, session->framed ? frame(0, message) : message);
     }
 }
 
@@ -184,10 +1386,21 @@ void NetworkServer::stop() {
         close(server_socket);
     }
     
-    // Close all client connections
+    if (uring_active) {
+        wakeReactor();
+    }
+    
+    if (supervisor.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(timers_mutex);
+        }
+        supervisor_wake.notify_all();
+        supervisor.join();
+    }
+    
+    // Wake every client thread; each closes its own socket on the way out
     std::lock_guard<std::mutex> lock(clients_mutex);
-    for (int socket : client_sockets) {
-        close(socket);
+    for (auto& [id, session] : sessions) {
+        shutdown(session->socket, SHUT_RDWR);
     }
-    client_sockets.clear();
 }
\ No newline at end of file
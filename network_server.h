@@ -2,36 +2,195 @@
 #define NETWORK_SERVER_H
 
 #include "trading_engine.h"
+#include "metrics.h"
+#include "risk.h"
+#include "token_bucket.h"
+#include "admission_queue.h"
+#include "timer_wheel.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <algorithm>
+
+class ShmGateway;
+
+// Per-connection state
+struct Session {
+    int session_id;
+    int socket;
+    bool cancel_on_disconnect;
+    int account_id;   // Risk account; DEFAULT until LOGON
+    bool has_orders;  // LOGON is only allowed before the first order
+    StpMode stp_mode; // Applies to orders sharing account_id; the DEFAULT account is exempt
+    
+    // Set once the client tags a request with "#<id> ". From then on every
+    // response is framed as "#<id> <length>\n<payload>" and the session also
+    // receives unsolicited FILL/CANCELED/QUOTE messages framed with id 0.
+    // A REPLACE shows up as a CANCELED of the old quantity whose REMAINING
+    // is the new one.
+    std::atomic<bool> framed;
+    
+    std::mutex send_mutex;  // Responses and pushes are written from different threads
+    
+    TokenBucket rate_limit;  // Commands from this connection; see NetworkOptions
+    
+    // steady_clock::time_since_epoch() when bytes last arrived
+    std::atomic<std::chrono::steady_clock::rep> last_input;
+    
+    std::string pending;  // Bytes received after the last complete line
+    bool skip_line = false;  // Dropping the rest of an overlong line up to its newline
+    std::string output;   // Framed response being assembled; reused across requests
+    
+    // io_uring backend only: messages waiting for the reactor to send them,
+    // guarded by send_mutex
+    std::deque<std::string> outbox;
+    
+    Session(int id, int sock)
+        : session_id(id), socket(sock), cancel_on_disconnect(false),
+          account_id(RiskManager::DEFAULT_ACCOUNT), has_orders(false), stp_mode(StpMode::CANCEL_NEWEST),
+          framed(false), last_input(0) {}
+};
+
+// Latency options for deployments on isolated cores. The defaults block in
+// recv and leave thread placement to the scheduler.
+struct NetworkOptions {
+    std::vector<int> client_cpus;  // Client threads are pinned round-robin over these
+    int accept_cpu = -1;           // CPU for the accept loop, -1 for none
+    bool spin = false;             // Poll sockets without blocking, pausing between empty polls
+    int busy_poll_usec = 0;        // SO_BUSY_POLL on client sockets, 0 to leave it off
+    bool use_uring = false;        // Serve every client from one io_uring reactor thread
+    
+    // Command rate limits applied before a line is parsed, per connection and
+    // per LOGON account across its connections; a rate of 0 is no limit.
+    // CANCEL of a single order is never throttled.
+    double session_rate = 0.0;
+    double session_burst = 100.0;
+    double account_rate = 0.0;
+    double account_burst = 100.0;
+    
+    // Order entry and cancels queue for one of engine_slots places in the
+    // engine (0 for one per hardware thread); past order_queue_depth waiting
+    // orders, new ones are rejected
+    int engine_slots = 0;
+    int order_queue_depth = 256;
+    
+    // Framed sessions that send nothing for heartbeat_ms get a HEARTBEAT
+    // push, repeated until they answer; any session silent for
+    // idle_timeout_ms (default three heartbeats) is disconnected. 0 for off.
+    int heartbeat_ms = 0;
+    int idle_timeout_ms = 0;
+};
 
 class NetworkServer {
 private:
+    static constexpr size_t MAX_COMMAND_LENGTH = 64 * 1024;
+    static constexpr size_t MAX_BATCH_ENTRIES = 256;
+    
     TradingEngine* engine;
+    RiskManager* risk;  // Optional pre-trade checks
+    NetworkOptions options;
     int server_socket;
     int port;
     std::atomic<bool> running;
+    std::atomic<int> next_session_id;
     
-    std::vector<int> client_sockets;
+    std::unordered_map<int, std::shared_ptr<Session>> sessions;
     std::mutex clients_mutex;
     
+    // Symbol -> IDs of sessions receiving QUOTE updates
+    std::unordered_map<std::string, std::unordered_set<int>> subscriptions;
+    std::mutex subscriptions_mutex;
+    
+    ServerMetrics metrics;
+    
+    // By account ID, when account_rate is set and accounts are enabled
+    std::unique_ptr<TokenBucket[]> account_limits;
+    
+    AdmissionQueue admission;
+    
+    // Idle checks by session ID; each session has one pending, and a read
+    // only stamps last_input, so the timer is moved lazily when it fires.
+    // Run by the io_uring reactor, or by the supervisor thread otherwise.
+    TimerWheel<int> idle_timers;
+    std::mutex timers_mutex;
+    std::thread supervisor;
+    std::condition_variable supervisor_wake;
+    
+    ShmGateway* gateway;  // Receives fills and cancels for its own sessions
+    
+    // io_uring backend: sessions with queued output, and an eventfd that
+    // wakes the reactor when they are queued from another thread
+    std::atomic<bool> uring_active;
+    std::thread::id reactor_thread;
+    std::vector<int> ready_sessions;
+    std::mutex ready_mutex;
+    int wake_fd;
+    
     // Thread functions
     void acceptClients();
-    void handleClient(int client_socket);
+    void configureClientSocket(int client_socket);
+    void handleClient(std::shared_ptr<Session> session);
+    bool serveUring();
+    void wakeReactor();
     
     // Protocol functions
-    std::string processCommand(const std::string& command);
+    std::string processCommand(std::string_view command, Session& session);
+    
+    // Runs every complete line in session.pending; returns false once the
+    // client has asked to disconnect
+    bool processInput(Session& session);
+    void closeSession(Session& session);
+    
+    // Charges a command to the session's and its account's rate limits;
+    // false if either is exhausted
+    bool admitCommand(Session& session, std::string_view command);
+    
+    // Takes an engine slot for a command; waits on a client thread, but
+    // never on the io_uring reactor, which serves every connection
+    bool enterEngine(AdmissionQueue::Lane lane);
+    
+    bool idleChecksEnabled() const { return options.idle_timeout_ms > 0; }
+    void watchIdle(int session_id, TimerWheel<int>::Clock::time_point deadline);
+    void expireIdleTimers();
+    void checkIdle(int session_id, TimerWheel<int>::Clock::time_point now);
+    void sendHeartbeat(Session& session);
+    void superviseSessions();
+    
+    bool sendAll(Session& session, const std::string& data);
+    void pushToSession(int session_id, const std::string& message);
+    void onFill(const Fill& fill);
+    void onCancel(const OrderCancel& cancel);
+    void onQuote(const Quote& quote);
+    void unsubscribeAll(int session_id);
     
 public:
-    NetworkServer(TradingEngine* eng, int p);
+    NetworkServer(TradingEngine* eng, int p, RiskManager* rm = nullptr,
+                  const NetworkOptions& opts = NetworkOptions());
     ~NetworkServer();
     
     void start();
     void stop();
     void broadcastMessage(const std::string& message);
+    
+    // Routes engine events for gateway sessions to the gateway and applies
+    // this server's throttles and engine admission to its requests; call
+    // before either starts
+    void attachGateway(ShmGateway* gw);
+    
+    // Numbers new sessions above last, so orders replayed from a primary
+    // keep owners no new session can be mistaken for; call before start()
+    void reserveSessionIds(int last) { next_session_id = std::max(next_session_id.load(), last + 1); }
+    
+    const ServerMetrics& getMetrics() const { return metrics; }
+    const RiskManager* getRiskManager() const { return risk; }
 };
 
 #endif // NETWORK_SERVER_H
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "numa.h"
+#include "cpu_affinity.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace {
+
+const std::string NODE_ROOT = "/sys/devices/system/node/";
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// "0-3,8-11" from a sorted CPU list
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::stringstream out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t end = i;
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) {
+            ++end;
+        }
+        out << (i > 0 ? "," : "") << cpus[i];
+        if (end > i) {
+            out << "-" << cpus[end];
+        }
+        i = end + 1;
+    }
+    return out.str();
+}
+
+size_t nodeCount() {
+    static const size_t count = readNumaNodes().size();
+    return count;
+}
+
+}
+
+std::vector<NumaNode> readNumaNodes() {
+    std::vector<NumaNode> nodes;
+    std::vector<int> ids;
+    if (!parseCpuList(readFirstLine(NODE_ROOT + "online"), ids)) {
+        return nodes;
+    }
+
+    for (int id : ids) {
+        NumaNode node;
+        node.id = id;
+        std::string dir = NODE_ROOT + "node" + std::to_string(id) + "/";
+        parseCpuList(readFirstLine(dir + "cpulist"), node.cpus);
+
+        // "Node 0 MemTotal:       16303676 kB"
+        std::ifstream meminfo(dir + "meminfo");
+        std::string line;
+        while (std::getline(meminfo, line)) {
+            std::stringstream fields(line);
+            std::string word, node_id, key;
+            int64_t value = 0;
+            fields >> word >> node_id >> key >> value;
+            if (key == "MemTotal:") {
+                node.total_kb = value;
+            } else if (key == "MemFree:") {
+                node.free_kb = value;
+            }
+        }
+
+        std::ifstream numastat(dir + "numastat");
+        std::string key;
+        uint64_t value;
+        while (numastat >> key >> value) {
+            if (key == "numa_hit") {
+                node.numa_hit = value;
+            } else if (key == "numa_miss") {
+                node.numa_miss = value;
+            } else if (key == "other_node") {
+                node.other_node = value;
+            }
+        }
+
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+int numaNodeOfCpu(int cpu) {
+    for (const NumaNode& node : readNumaNodes()) {
+        for (int node_cpu : node.cpus) {
+            if (node_cpu == cpu) {
+                return node.id;
+            }
+        }
+    }
+    return -1;
+}
+
+int currentNumaNode() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
+
+int numaNodeOfAddress(const void* addr) {
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+        return -1;
+    }
+    return node;
+}
+
+std::string describeNuma() {
+    std::vector<NumaNode> nodes = readNumaNodes();
+    if (nodes.empty()) {
+        return "NUMA: no topology reported by the kernel, placement disabled\n";
+    }
+
+    std::stringstream out;
+    out << "NUMA: " << nodes.size() << (nodes.size() == 1 ? " node, placement disabled\n" : " nodes\n");
+    out << std::fixed << std::setprecision(1);
+    for (const NumaNode& node : nodes) {
+        out << "  node " << node.id << ": cpus " << formatCpuList(node.cpus) << ", "
+            << node.total_kb / 1048576.0 << " GiB total, " << node.free_kb / 1048576.0 << " GiB free, "
+            << "numa_hit " << node.numa_hit << ", numa_miss " << node.numa_miss
+            << ", other_node " << node.other_node << "\n";
+    }
+    return out.str();
+}
+
+ScopedNumaPreference::ScopedNumaPreference(int node)
+    : applied(false), previous_mode(MPOL_DEFAULT), previous_mask{} {
+    if (node < 0 || node >= MAX_NODES || nodeCount() < 2) {
+        return;
+    }
+    if (syscall(SYS_get_mempolicy, &previous_mode, previous_mask, MAX_NODES, nullptr, 0) != 0) {
+        return;
+    }
+
+    const size_t bits = 8 * sizeof(unsigned long);
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    mask[node / bits] |= 1UL << (node % bits);
+    applied = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MAX_NODES) == 0;
+}
+
+ScopedNumaPreference::~ScopedNumaPreference() {
+    if (applied) {
+        syscall(SYS_set_mempolicy, previous_mode, previous_mode == MPOL_DEFAULT ? nullptr : previous_mask,
+                MAX_NODES);
+    }
+}
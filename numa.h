@@ -0,0 +1,59 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// NUMA topology from sysfs, and memory placement through the mbind,
+// set_mempolicy and get_mempolicy syscalls, so libnuma is not required. On
+// single-node machines, or kernels built without NUMA, there is nothing to
+// place and the placement helpers do nothing.
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+    int64_t total_kb = 0;
+    int64_t free_kb = 0;
+    uint64_t numa_hit = 0;    // Allocations satisfied on this node as intended
+    uint64_t numa_miss = 0;   // Allocations that landed here but wanted another node
+    uint64_t other_node = 0;  // Allocations here by a process running elsewhere
+};
+
+// Online nodes; empty if the kernel exposes none
+std::vector<NumaNode> readNumaNodes();
+
+// Node of a CPU, or -1 if unknown
+int numaNodeOfCpu(int cpu);
+
+// Node of the CPU the calling thread is running on, or -1
+int currentNumaNode();
+
+// Node holding the page at addr (faulting it in if needed), or -1
+int numaNodeOfAddress(const void* addr);
+
+// Startup report: nodes, their CPUs, memory and allocation counters
+std::string describeNuma();
+
+// While alive, new pages the calling thread faults in prefer node; the
+// thread's previous policy is restored on destruction. Does nothing for a
+// node below 0 or on a machine with a single node.
+class ScopedNumaPreference {
+public:
+    explicit ScopedNumaPreference(int node);
+    ~ScopedNumaPreference();
+
+    ScopedNumaPreference(const ScopedNumaPreference&) = delete;
+    ScopedNumaPreference& operator=(const ScopedNumaPreference&) = delete;
+
+    bool active() const { return applied; }
+
+private:
+    static constexpr int MAX_NODES = 1024;
+
+    bool applied;
+    int previous_mode;
+    unsigned long previous_mask[MAX_NODES / (8 * sizeof(unsigned long))];
+};
+
+#endif // NUMA_H
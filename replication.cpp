@@ -0,0 +1,563 @@
+#include "replication.h"
+#include "logger.h"
+#include "shm_gateway.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 1 << 20;
+constexpr int POLL_MS = 100;  // How often blocked threads look at stop, promote and acks
+constexpr size_t RECEIVE_BUFFER = 64 * 1024;
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    put(out, static_cast<uint16_t>(value.size()));
+    out += value;
+}
+
+// A record is its length as a uint32_t, then the command's fields in order
+void encodeCommand(const EngineCommand& command, std::string& out) {
+    out.clear();
+    put(out, uint32_t(0));
+    put(out, command.sequence);
+    put(out, command.time);
+    put(out, command.next_order_id);
+    put(out, static_cast<uint8_t>(command.type));
+    put(out, static_cast<uint8_t>(command.side));
+    put(out, static_cast<uint8_t>(command.any_side));
+    put(out, static_cast<uint8_t>(command.stp_mode));
+    put(out, static_cast<uint8_t>(command.book_type));
+    put(out, command.price);
+    put(out, command.stop_price);
+    put(out, command.tick_size);
+    put(out, command.quantity);
+    put(out, command.display_quantity);
+    put(out, command.order_id);
+    put(out, command.session_id);
+    put(out, command.owner_id);
+    putString(out, command.symbol);
+    putString(out, command.buy_leg);
+    putString(out, command.sell_leg);
+    put(out, static_cast<uint32_t>(command.batch.size()));
+    for (const BatchEntry& entry : command.batch) {
+        put(out, static_cast<uint8_t>(entry.type));
+        put(out, static_cast<uint8_t>(entry.side));
+        put(out, entry.price);
+        put(out, entry.quantity);
+        put(out, entry.order_id);
+        putString(out, entry.symbol);
+    }
+    uint32_t length = static_cast<uint32_t>(out.size() - sizeof(uint32_t));
+    std::memcpy(out.data(), &length, sizeof(length));
+}
+
+// Reads one record's fields in order; any read past the end fails the record
+class RecordReader {
+public:
+    RecordReader(const char* data, size_t size) : cursor(data), end(data + size), ok(true) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    template <typename Enum>
+    Enum getEnum(uint8_t count) {
+        uint8_t value = get<uint8_t>();
+        ok = ok && value < count;
+        return static_cast<Enum>(value);
+    }
+
+    void getString(std::string& value) {
+        uint16_t size = get<uint16_t>();
+        if (static_cast<size_t>(end - cursor) < size) {
+            ok = false;
+            return;
+        }
+        value.assign(cursor, size);
+        cursor += size;
+    }
+
+    bool good() const { return ok; }
+    bool complete() const { return ok && cursor == end; }
+
+private:
+    const char* cursor;
+    const char* end;
+    bool ok;
+};
+
+bool decodeCommand(const char* data, size_t size, EngineCommand& command) {
+    RecordReader in(data, size);
+    command.sequence = in.get<uint64_t>();
+    command.time = in.get<int64_t>();
+    command.next_order_id = in.get<int>();
+    command.type = in.getEnum<EngineCommand::Type>(static_cast<uint8_t>(EngineCommand::Type::ACCOUNT) + 1);
+    command.side = in.getEnum<OrderSide>(2);
+    command.any_side = in.get<uint8_t>() != 0;
+    command.stp_mode = in.getEnum<StpMode>(static_cast<uint8_t>(StpMode::DECREMENT) + 1);
+    command.book_type = in.getEnum<BookType>(static_cast<uint8_t>(BookType::LADDER) + 1);
+    command.price = in.get<double>();
+    command.stop_price = in.get<double>();
+    command.tick_size = in.get<double>();
+    command.quantity = in.get<int>();
+    command.display_quantity = in.get<int>();
+    command.order_id = in.get<int>();
+    command.session_id = in.get<int>();
+    command.owner_id = in.get<int>();
+    in.getString(command.symbol);
+    in.getString(command.buy_leg);
+    in.getString(command.sell_leg);
+    uint32_t entries = in.get<uint32_t>();
+    command.batch.clear();
+    for (uint32_t i = 0; i < entries && in.good(); ++i) {
+        BatchEntry entry;
+        entry.type = in.getEnum<BatchEntry::Type>(2);
+        entry.side = in.getEnum<OrderSide>(2);
+        entry.price = in.get<double>();
+        entry.quantity = in.get<int>();
+        entry.order_id = in.get<int>();
+        in.getString(entry.symbol);
+        command.batch.push_back(std::move(entry));
+    }
+    return in.complete() && command.batch.size() == entries;
+}
+
+// Parses "unix:<path>", "<host>:<port>" or "<port>"
+bool parseAddress(const std::string& address, sockaddr_storage& storage, socklen_t& length, std::string& error) {
+    std::memset(&storage, 0, sizeof(storage));
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        auto* unix_addr = reinterpret_cast<sockaddr_un*>(&storage);
+        if (path.empty() || path.size() >= sizeof(unix_addr->sun_path)) {
+            error = "Invalid Unix socket path: " + path;
+            return false;
+        }
+        unix_addr->sun_family = AF_UNIX;
+        std::memcpy(unix_addr->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+
+    size_t colon = address.rfind(':');
+    std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+    std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+    auto* inet_addr = reinterpret_cast<sockaddr_in*>(&storage);
+    inet_addr->sin_family = AF_INET;
+    int port_number = 0;
+    try {
+        size_t used = 0;
+        port_number = std::stoi(port, &used);
+        if (used != port.size()) {
+            port_number = 0;
+        }
+    } catch (const std::exception&) {
+    }
+    if (port_number <= 0 || port_number > 65535 || inet_pton(AF_INET, host.c_str(), &inet_addr->sin_addr) != 1) {
+        error = "Invalid replication address: " + address;
+        return false;
+    }
+    inet_addr->sin_port = htons(static_cast<uint16_t>(port_number));
+    length = sizeof(sockaddr_in);
+    return true;
+}
+
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Waits up to POLL_MS for fd to become readable; false on timeout
+bool waitReadable(int fd) {
+    pollfd entry{fd, POLLIN, 0};
+    return poll(&entry, 1, POLL_MS) > 0;
+}
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+// Primary
+
+ReplicationPrimary::ReplicationPrimary(ReplicationStats& s)
+    : stats(s), listen_fd(-1), running(false), journal_bytes(0), first_sequence(1), streaming(false),
+      sender_waiting(false) {
+    encoded.reserve(256);
+}
+
+ReplicationPrimary::~ReplicationPrimary() {
+    stop();
+}
+
+bool ReplicationPrimary::start(const std::string& address, std::string& error) {
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!parseAddress(address, addr, length, error)) {
+        return false;
+    }
+
+    listen_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    if (addr.ss_family == AF_UNIX) {
+        unix_path = reinterpret_cast<sockaddr_un*>(&addr)->sun_path;
+        unlink(unix_path.c_str());
+    } else {
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), length) < 0 || listen(listen_fd, 1) < 0) {
+        error = "Cannot listen on " + address + ": " + std::strerror(errno);
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    running = true;
+    sender = std::thread(&ReplicationPrimary::serve, this);
+    LOG_INFO("[REPLICATION] Primary journaling, standby may connect on {}", address);
+    return true;
+}
+
+void ReplicationPrimary::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+    }
+    journal_grew.notify_all();
+    sender.join();
+    close(listen_fd);
+    listen_fd = -1;
+    if (!unix_path.empty()) {
+        unlink(unix_path.c_str());
+    }
+}
+
+void ReplicationPrimary::append(const EngineCommand& command) {
+    encodeCommand(command, encoded);
+
+    bool wake;
+    std::deque<std::unique_ptr<Chunk>> unused;  // Freed once journal_mutex is released
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        if (chunks.empty() || chunks.back()->capacity - chunks.back()->size < encoded.size()) {
+            // With no standby attached, the full chunks are only worth
+            // keeping while one could still join and replay them
+            if (!streaming && !chunks.empty() && (first_sequence > 1 || journal_bytes >= replication::JOURNAL_LIMIT)) {
+                if (first_sequence == 1) {
+                    LOG_WARN("[REPLICATION] Journal reached {} MiB with no standby attached; freeing it, so no "
+                             "standby can join this primary", journal_bytes >> 20);
+                }
+                first_sequence = chunks.back()->last_sequence + 1;
+                journal_bytes = 0;
+                unused.swap(chunks);
+            }
+            auto chunk = std::make_unique<Chunk>();
+            chunk->capacity = std::max(CHUNK_SIZE, encoded.size());
+            chunk->data = std::make_unique<char[]>(chunk->capacity);
+            chunk->size = 0;
+            journal_bytes += chunk->capacity;
+            chunks.push_back(std::move(chunk));
+        }
+        Chunk& chunk = *chunks.back();
+        std::memcpy(chunk.data.get() + chunk.size, encoded.data(), encoded.size());
+        chunk.size += encoded.size();
+        chunk.last_sequence = command.sequence;
+        wake = sender_waiting;
+        stats.journal_bytes.set(static_cast<int64_t>(journal_bytes));
+    }
+    if (wake) {
+        journal_grew.notify_one();
+    }
+    stats.sequence.set(static_cast<int64_t>(command.sequence));
+}
+
+void ReplicationPrimary::serve() {
+    while (running) {
+        if (!waitReadable(listen_fd)) {
+            continue;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        // The hello is the only thing a standby sends before its acks
+        timeval timeout{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        uint64_t magic = 0;
+        if (recv(fd, &magic, sizeof(magic), MSG_WAITALL) != sizeof(magic) || magic != replication::MAGIC) {
+            LOG_WARN("[REPLICATION] Rejected a connection that is not a standby");
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        // The reply is the first sequence the journal still holds; a
+        // standby can only use 1
+        uint64_t first;
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex);
+            first = first_sequence;
+            streaming = first == 1;
+        }
+        if (!sendAll(fd, reinterpret_cast<const char*>(&first), sizeof(first)) || first != 1) {
+            LOG_WARN("[REPLICATION] Refused a standby: the journal before sequence {} has been freed", first);
+            close(fd);
+            continue;
+        }
+
+        LOG_INFO("[REPLICATION] Standby connected, sending the journal from sequence 1");
+        stats.standby_connected.set(1);
+        stream(fd);
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex);
+            streaming = false;
+        }
+        stats.standby_connected.set(0);
+        close(fd);
+        LOG_INFO("[REPLICATION] Standby disconnected");
+    }
+}
+
+void ReplicationPrimary::stream(int fd) {
+    size_t chunk_index = 0;
+    size_t offset = 0;
+    char acks[RECEIVE_BUFFER];
+    size_t ack_bytes = 0;
+
+    while (running) {
+        // Everything journaled since the last send goes in one write
+        const char* data = nullptr;
+        size_t size = 0;
+        {
+            std::unique_lock<std::mutex> lock(journal_mutex);
+            auto available = [&]() {
+                while (chunk_index < chunks.size() && offset == chunks[chunk_index]->size &&
+                       chunk_index + 1 < chunks.size()) {
+                    ++chunk_index;
+                    offset = 0;
+                }
+                return chunk_index < chunks.size() && offset < chunks[chunk_index]->size;
+            };
+            if (!available() && running) {
+                sender_waiting = true;
+                journal_grew.wait_for(lock, std::chrono::milliseconds(POLL_MS));
+                sender_waiting = false;
+            }
+            if (available()) {
+                data = chunks[chunk_index]->data.get() + offset;
+                size = chunks[chunk_index]->size - offset;
+            }
+        }
+        if (size > 0) {
+            if (!sendAll(fd, data, size)) {
+                return;
+            }
+            offset += size;
+            stats.bytes.add(size);
+            stats.batches.add();
+        }
+
+        // Acks are the standby's applied sequence; only the newest matters
+        ssize_t received = recv(fd, acks + ack_bytes, sizeof(acks) - ack_bytes, MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return;
+        }
+        if (received > 0) {
+            ack_bytes += received;
+            size_t whole = ack_bytes / sizeof(uint64_t) * sizeof(uint64_t);
+            if (whole == 0) {
+                continue;
+            }
+            uint64_t acked;
+            std::memcpy(&acked, acks + whole - sizeof(uint64_t), sizeof(acked));
+            stats.acked_sequence.set(static_cast<int64_t>(acked));
+            chunk_index -= release(acked, chunk_index);
+            std::memmove(acks, acks + whole, ack_bytes - whole);
+            ack_bytes -= whole;
+        }
+    }
+}
+
+size_t ReplicationPrimary::release(uint64_t acked, size_t chunk_index) {
+    std::deque<std::unique_ptr<Chunk>> applied;  // Freed once journal_mutex is released
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        while (applied.size() < chunk_index && chunks.front()->last_sequence <= acked) {
+            journal_bytes -= chunks.front()->capacity;
+            first_sequence = chunks.front()->last_sequence + 1;
+            applied.push_back(std::move(chunks.front()));
+            chunks.pop_front();
+        }
+        stats.journal_bytes.set(static_cast<int64_t>(journal_bytes));
+    }
+    return applied.size();
+}
+
+// Standby
+
+ReplicationStandby::ReplicationStandby(TradingEngine* eng, RiskManager* rm, ReplicationStats& s)
+    : engine(eng), risk(rm), stats(s), fd(-1), promoted(false), last_session_id(0), last_gateway_session_id(0) {
+}
+
+ReplicationStandby::~ReplicationStandby() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool ReplicationStandby::connect(const std::string& address, std::string& error) {
+    sockaddr_storage addr;
+    socklen_t length;
+    if (!parseAddress(address, addr, length, error)) {
+        return false;
+    }
+
+    fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), length) < 0) {
+        error = "Cannot connect to primary at " + address + ": " + std::strerror(errno);
+        return false;
+    }
+    if (addr.ss_family == AF_INET) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    uint64_t magic = replication::MAGIC;
+    if (!sendAll(fd, reinterpret_cast<const char*>(&magic), sizeof(magic))) {
+        error = "Primary at " + address + " closed the connection";
+        return false;
+    }
+
+    // The primary answers with the first sequence it still holds. It only
+    // answers one standby at a time, so a wait means another is attached.
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint64_t first = 0;
+    if (recv(fd, &first, sizeof(first), MSG_WAITALL) != sizeof(first)) {
+        error = "Primary at " + address + " did not accept a standby; is another attached?";
+        return false;
+    }
+    if (first != 1) {
+        error = "Primary at " + address + " has freed its journal before sequence " + std::to_string(first) +
+                ", so no standby can join it";
+        return false;
+    }
+    timeout = timeval{0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    LOG_INFO("[REPLICATION] Standby of {}", address);
+    return true;
+}
+
+bool ReplicationStandby::run() {
+    std::unique_ptr<char[]> buffer(new char[RECEIVE_BUFFER]);
+    uint64_t applied = 0;
+
+    while (!promoted.load(std::memory_order_relaxed)) {
+        if (!waitReadable(fd)) {
+            continue;
+        }
+        ssize_t received = recv(fd, buffer.get(), RECEIVE_BUFFER, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            LOG_WARN("[REPLICATION] Primary went away after sequence {}", applied);
+            break;
+        }
+        stats.bytes.add(received);
+        stats.batches.add();
+        pending.append(buffer.get(), received);
+
+        size_t position = 0;
+        uint32_t length;
+        while (pending.size() - position >= sizeof(length)) {
+            std::memcpy(&length, pending.data() + position, sizeof(length));
+            if (pending.size() - position - sizeof(length) < length) {
+                break;
+            }
+            const char* record = pending.data() + position + sizeof(length);
+            position += sizeof(length) + length;
+
+            if (!decodeCommand(record, length, command) || command.sequence != applied + 1) {
+                LOG_ERROR("[REPLICATION] Corrupt or out-of-order record after sequence {}", applied);
+                return false;
+            }
+            // Accounts are numbered in the order they were created, so
+            // replayed orders name the same accounts here
+            bool account_matches = command.type != EngineCommand::Type::ACCOUNT || !risk ||
+                                   risk->registerAccount(command.symbol) == command.owner_id;
+            if (!account_matches || !engine->replay(command)) {
+                LOG_ERROR("[REPLICATION] Diverged from the primary at sequence {}", command.sequence);
+                return false;
+            }
+            applied = command.sequence;
+
+            // The shared-memory gateway numbers its sessions apart from the network's
+            if (command.session_id < ShmGateway::SESSION_ID_BASE) {
+                last_session_id = std::max(last_session_id, command.session_id);
+            } else {
+                last_gateway_session_id = std::max(last_gateway_session_id, command.session_id);
+            }
+            if (command.type == EngineCommand::Type::SPREAD && risk && engine->isSpread(command.symbol)) {
+                risk->markSpread(command.symbol);
+            }
+        }
+        pending.erase(0, position);
+
+        if (applied > 0) {
+            stats.sequence.set(static_cast<int64_t>(applied));
+            stats.lag_us.set(std::max<int64_t>(nowMicros() - command.time, 0));
+            // The primary frees its journal up to the acked sequence, so a
+            // dropped ack would hold memory until the next batch; a lost
+            // connection shows up on the next read
+            sendAll(fd, reinterpret_cast<const char*>(&applied), sizeof(applied));
+        }
+    }
+
+    // Replayed fills and cancels kept positions current, but the orders
+    // were never checked here, so open-order counts come from the books
+    if (risk) {
+        risk->restoreOpenOrders(engine->openOrdersByOwner());
+    }
+    return true;
+}
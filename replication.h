@@ -0,0 +1,134 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "trading_engine.h"
+#include "metrics.h"
+#include "risk.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Primary/standby replication of the engine's journal. The primary's engine
+// journals every state-changing call as an EngineCommand, in the order the
+// calls took effect; the primary keeps the encoded journal in memory and
+// streams it to a standby process, which replays it into its own engine and
+// reports the last sequence applied. Replication is asynchronous: the
+// primary never waits for the standby, and its lag is exported instead.
+//
+// A standby always starts from sequence 1. The primary keeps its journal
+// until a standby acknowledges it, so one can attach late and catch up,
+// but frees each chunk a standby has acknowledged; after that, or once the
+// journal outgrows JOURNAL_LIMIT with no standby attached, it refuses new
+// standbys, which then exit rather than serve. When the primary goes away,
+// or on promote(), the standby stops applying and its process takes over
+// serving clients. Sessions are
+// not replicated: clients reconnect and LOGON again, and new sessions are
+// numbered above every replayed one. Risk accounts are journaled as they
+// are created, so replayed orders keep their accounts; positions follow
+// the replayed fills and open-order counts are rebuilt on promotion.
+//
+// Addresses are "unix:<path>", "<host>:<port>" or "<port>" on 127.0.0.1.
+// Records are in host byte order; both ends run on the same kind of host.
+namespace replication {
+
+constexpr uint64_t MAGIC = 0x314c50524e474e45;  // "ENGNRPL1", sent by the standby on connect
+constexpr size_t JOURNAL_LIMIT = size_t(1) << 30;  // Bytes kept for a standby yet to attach
+
+}
+
+class ReplicationPrimary {
+public:
+    explicit ReplicationPrimary(ReplicationStats& stats);
+    ~ReplicationPrimary();
+
+    ReplicationPrimary(const ReplicationPrimary&) = delete;
+    ReplicationPrimary& operator=(const ReplicationPrimary&) = delete;
+
+    // Listens for a standby on address and starts the sender thread; false
+    // with error set if the address cannot be bound
+    bool start(const std::string& address, std::string& error);
+    void stop();
+
+    // Handler for TradingEngine::setJournal; the engine calls it one
+    // command at a time
+    void append(const EngineCommand& command);
+
+private:
+    // Journal storage; a record never spans chunks, so a chunk is only
+    // written at its end and only the newest one grows
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t size;             // Guarded by journal_mutex
+        uint64_t last_sequence;  // Of its newest record; guarded by journal_mutex
+    };
+
+    ReplicationStats& stats;
+    std::string unix_path;  // Removed on stop
+    int listen_fd;
+    std::atomic<bool> running;
+    std::thread sender;
+
+    std::string encoded;  // Scratch for append
+
+    std::mutex journal_mutex;
+    std::condition_variable journal_grew;
+    std::deque<std::unique_ptr<Chunk>> chunks;
+    size_t journal_bytes;     // Capacity of chunks
+    uint64_t first_sequence;  // Oldest record kept; a standby can only join while it is 1
+    bool streaming;           // A standby is attached, so chunks are freed as it acknowledges them
+    bool sender_waiting;      // Appends only notify a sender that is waiting
+
+    void serve();
+    void stream(int fd);  // Sends the journal to one standby until it goes away
+
+    // Frees the chunks a standby has applied, except any the sender is
+    // still positioned in; returns how many
+    size_t release(uint64_t acked, size_t chunk_index);
+};
+
+class ReplicationStandby {
+public:
+    // risk, if given, learns the spreads the journal defines, as the
+    // network layer tells it on the primary
+    ReplicationStandby(TradingEngine* engine, RiskManager* risk, ReplicationStats& stats);
+    ~ReplicationStandby();
+
+    ReplicationStandby(const ReplicationStandby&) = delete;
+    ReplicationStandby& operator=(const ReplicationStandby&) = delete;
+
+    bool connect(const std::string& address, std::string& error);
+
+    // Applies the primary's journal until the primary goes away or
+    // promote() is called. False if a record was corrupt or this engine
+    // diverged from the primary's, after which it must not serve.
+    bool run();
+
+    // Ends run() within one poll interval; safe to call from a signal handler
+    void promote() { promoted.store(true, std::memory_order_relaxed); }
+
+    // Highest network and shared-memory session IDs in the journal; the
+    // promoted server numbers its own above them so old orders keep their
+    // owners
+    int lastSessionId() const { return last_session_id; }
+    int lastGatewaySessionId() const { return last_gateway_session_id; }
+
+private:
+    TradingEngine* engine;
+    RiskManager* risk;
+    ReplicationStats& stats;
+    int fd;
+    std::atomic<bool> promoted;
+    int last_session_id;
+    int last_gateway_session_id;
+
+    std::string pending;     // Bytes received after the last complete record
+    EngineCommand command;   // Reused for each record
+};
+
+#endif // REPLICATION_H
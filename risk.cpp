@@ -0,0 +1,247 @@
+#include "risk.h"
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+
+RiskManager::RiskManager(const RiskLimits& l)
+    : limits(l), account_count(0), symbol_count(0) {
+    for (auto& account : accounts) {
+        account.store(nullptr, std::memory_order_relaxed);
+    }
+    for (auto& entry : symbol_table) {
+        entry.store(nullptr, std::memory_order_relaxed);
+    }
+    registerAccount("DEFAULT");
+}
+
+RiskManager::~RiskManager() {
+    for (auto& account : accounts) {
+        delete account.load(std::memory_order_relaxed);
+    }
+    for (auto& entry : symbol_table) {
+        delete entry.load(std::memory_order_relaxed);
+    }
+}
+
+int RiskManager::registerAccount(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    for (int i = 0; i < account_count; ++i) {
+        if (accounts[i].load(std::memory_order_relaxed)->name == name) {
+            return i;
+        }
+    }
+    if (account_count == MAX_ACCOUNTS) {
+        return -1;
+    }
+
+    auto* account = new AccountRisk();
+    account->name = name;
+    account->order_rate.configure(limits.max_orders_per_second, limits.order_burst);
+    account->positions.reset(new std::atomic<int64_t>[MAX_SYMBOLS]);
+    for (int i = 0; i < MAX_SYMBOLS; ++i) {
+        account->positions[i].store(0, std::memory_order_relaxed);
+    }
+
+    accounts[account_count].store(account, std::memory_order_release);
+    if (account_handler) {
+        account_handler(account_count, name);
+    }
+    return account_count++;
+}
+
+const std::string& RiskManager::accountName(int account_id) const {
+    return findAccount(account_id)->name;
+}
+
+RiskManager::AccountRisk* RiskManager::findAccount(int account_id) const {
+    if (account_id < 0 || account_id >= MAX_ACCOUNTS) {
+        return accounts[DEFAULT_ACCOUNT].load(std::memory_order_acquire);
+    }
+    AccountRisk* account = accounts[account_id].load(std::memory_order_acquire);
+    return account ? account : accounts[DEFAULT_ACCOUNT].load(std::memory_order_acquire);
+}
+
+RiskManager::SymbolRisk* RiskManager::findSymbol(const std::string& symbol) const {
+    size_t slot = std::hash<std::string>{}(symbol) & (SYMBOL_TABLE_SIZE - 1);
+
+    // Linear probing; entries are never removed, so an empty slot ends the search
+    for (int probes = 0; probes < SYMBOL_TABLE_SIZE; ++probes) {
+        SymbolRisk* entry = symbol_table[slot].load(std::memory_order_acquire);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        if (entry->symbol == symbol) {
+            return entry;
+        }
+        slot = (slot + 1) & (SYMBOL_TABLE_SIZE - 1);
+    }
+    return nullptr;
+}
+
+RiskManager::SymbolRisk* RiskManager::getOrCreateSymbol(const std::string& symbol) {
+    if (SymbolRisk* entry = findSymbol(symbol)) {
+        return entry;
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // Another thread may have added it while we waited
+    if (SymbolRisk* entry = findSymbol(symbol)) {
+        return entry;
+    }
+    if (symbol_count == MAX_SYMBOLS) {
+        return nullptr;
+    }
+
+    auto* entry = new SymbolRisk();
+    entry->symbol = symbol;
+    entry->index = symbol_count++;
+
+    size_t slot = std::hash<std::string>{}(symbol) & (SYMBOL_TABLE_SIZE - 1);
+    while (symbol_table[slot].load(std::memory_order_relaxed) != nullptr) {
+        slot = (slot + 1) & (SYMBOL_TABLE_SIZE - 1);
+    }
+    symbol_table[slot].store(entry, std::memory_order_release);
+    return entry;
+}
+
+void RiskManager::markSpread(const std::string& symbol) {
+    if (SymbolRisk* sym = getOrCreateSymbol(symbol)) {
+        sym->spread.store(true, std::memory_order_relaxed);
+    }
+}
+
+std::string RiskManager::checkOrderTerms(SymbolRisk* sym, double price, int quantity) {
+    if (quantity > limits.max_order_quantity) {
+        stats.order_size_rejects.add();
+        return "ERROR: Risk reject: quantity exceeds max order size of " +
+               std::to_string(limits.max_order_quantity) + "\n";
+    }
+
+    if (std::fabs(price) * quantity > limits.max_order_notional) {
+        stats.notional_rejects.add();
+        return "ERROR: Risk reject: notional exceeds max order notional\n";
+    }
+
+    // Band around the last trade, or the BBO midpoint before the first trade
+    if (limits.price_band > 0 && !sym->spread.load(std::memory_order_relaxed)) {
+        double reference = sym->last_trade_price.load(std::memory_order_relaxed);
+        if (reference <= 0) {
+            reference = sym->mid_price.load(std::memory_order_relaxed);
+        }
+        if (reference > 0 && std::fabs(price - reference) > reference * limits.price_band) {
+            stats.price_band_rejects.add();
+            std::stringstream msg;
+            msg << "ERROR: Risk reject: price outside band around $" << std::fixed
+                << std::setprecision(2) << reference << "\n";
+            return msg.str();
+        }
+    }
+
+    return "";
+}
+
+std::string RiskManager::checkNewOrder(int account_id, const std::string& symbol, OrderSide side,
+                                       double price, int quantity) {
+    stats.checks.add();
+
+    SymbolRisk* sym = getOrCreateSymbol(symbol);
+    if (sym == nullptr) {
+        return "ERROR: Risk reject: symbol limit reached\n";
+    }
+
+    std::string terms = checkOrderTerms(sym, price, quantity);
+    if (!terms.empty()) {
+        return terms;
+    }
+
+    AccountRisk* account = findAccount(account_id);
+
+    int64_t position = account->positions[sym->index].load(std::memory_order_relaxed);
+    int64_t projected = position + (side == OrderSide::BUY ? quantity : -quantity);
+    if (std::llabs(projected) > limits.max_position) {
+        stats.position_rejects.add();
+        return "ERROR: Risk reject: order would exceed position limit\n";
+    }
+
+    if (!account->order_rate.tryConsume()) {
+        stats.rate_rejects.add();
+        return "ERROR: Risk reject: order rate limit exceeded\n";
+    }
+
+    // Count the order as open up front; it is released on fill or cancel
+    if (account->open_orders.fetch_add(1, std::memory_order_relaxed) >= limits.max_open_orders) {
+        account->open_orders.fetch_sub(1, std::memory_order_relaxed);
+        stats.open_order_rejects.add();
+        return "ERROR: Risk reject: too many open orders\n";
+    }
+
+    return "";
+}
+
+std::string RiskManager::checkReplace(int account_id, const std::string& symbol, double price, int quantity) {
+    stats.checks.add();
+
+    SymbolRisk* sym = getOrCreateSymbol(symbol);
+    if (sym == nullptr) {
+        return "ERROR: Risk reject: symbol limit reached\n";
+    }
+
+    std::string terms = checkOrderTerms(sym, price, quantity);
+    if (!terms.empty()) {
+        return terms;
+    }
+
+    if (!findAccount(account_id)->order_rate.tryConsume()) {
+        stats.rate_rejects.add();
+        return "ERROR: Risk reject: order rate limit exceeded\n";
+    }
+    return "";
+}
+
+void RiskManager::releaseOpenOrders(int account_id, int count) {
+    findAccount(account_id)->open_orders.fetch_sub(count, std::memory_order_relaxed);
+}
+
+void RiskManager::restoreOpenOrders(const std::unordered_map<int, int>& by_account) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    for (int i = 0; i < account_count; ++i) {
+        auto count = by_account.find(i);
+        accounts[i].load(std::memory_order_relaxed)->open_orders.store(
+            count == by_account.end() ? 0 : count->second, std::memory_order_relaxed);
+    }
+}
+
+void RiskManager::onFill(const Fill& fill) {
+    SymbolRisk* sym = getOrCreateSymbol(fill.symbol);
+    if (sym == nullptr) {
+        return;
+    }
+
+    sym->last_trade_price.store(fill.price, std::memory_order_relaxed);
+
+    AccountRisk* account = findAccount(fill.owner_id);
+    account->positions[sym->index].fetch_add(fill.side == OrderSide::BUY ? fill.quantity : -fill.quantity,
+                                             std::memory_order_relaxed);
+    if (fill.remaining == 0) {
+        account->open_orders.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void RiskManager::onCancel(const OrderCancel& cancel) {
+    if (cancel.remaining == 0) {
+        findAccount(cancel.owner_id)->open_orders.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void RiskManager::onQuote(const Quote& quote) {
+    if (quote.bid_price <= 0 || quote.ask_price <= 0) {
+        return;
+    }
+    if (SymbolRisk* sym = getOrCreateSymbol(quote.symbol)) {
+        sym->mid_price.store((quote.bid_price + quote.ask_price) / 2.0, std::memory_order_relaxed);
+    }
+}
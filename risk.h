@@ -0,0 +1,117 @@
+#ifndef RISK_H
+#define RISK_H
+
+#include "trading_engine.h"
+#include "token_bucket.h"
+#include "metrics.h"
+#include <string>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+struct RiskLimits {
+    int max_order_quantity = 100000;
+    double max_order_notional = 10000000.0;
+    double price_band = 0.10;            // Max distance from the reference price as a fraction, 0 disables
+    int64_t max_position = 1000000;      // Absolute net position per account and symbol
+    int max_open_orders = 10000;         // Resting orders per account
+    double max_orders_per_second = 0.0;  // Per account, 0 disables
+    double order_burst = 100.0;
+};
+
+struct RiskStats {
+    ShardedCounter checks;
+    ShardedCounter order_size_rejects;
+    ShardedCounter notional_rejects;
+    ShardedCounter price_band_rejects;
+    ShardedCounter position_rejects;
+    ShardedCounter open_order_rejects;
+    ShardedCounter rate_rejects;
+};
+
+// Pre-trade risk checks run before an order reaches the engine. Every
+// lookup on the order path is a fixed-size table probe and every update an
+// atomic, so checks never take a lock. Limits are checked against current
+// state without reserving it, so two racing orders may both pass a
+// position check they would fail together; the next order sees the result.
+class RiskManager {
+public:
+    static constexpr int MAX_ACCOUNTS = 4096;
+    static constexpr int MAX_SYMBOLS = 1024;
+    static constexpr int DEFAULT_ACCOUNT = 0;  // Sessions that never LOGON
+
+    explicit RiskManager(const RiskLimits& limits);
+    ~RiskManager();
+
+    // Returns the account's ID, creating it on first use; -1 if the table is full
+    int registerAccount(const std::string& name);
+
+    // Sees each account created from then on, in ID order, e.g. to journal
+    // it for a standby. Install before any LOGON.
+    void setAccountHandler(std::function<void(int account_id, const std::string& name)> handler) {
+        account_handler = std::move(handler);
+    }
+    const std::string& accountName(int account_id) const;
+
+    // Each returns an empty string if the order passes, otherwise the error
+    // response. A passing new order is counted as open for the account.
+    std::string checkNewOrder(int account_id, const std::string& symbol, OrderSide side,
+                              double price, int quantity);
+    std::string checkReplace(int account_id, const std::string& symbol, double price, int quantity);
+
+    // Spread prices sit around zero, so spreads skip the price band and their
+    // notional uses the absolute price
+    void markSpread(const std::string& symbol);
+
+    // Undo the open-order count of orders that passed but were never sent
+    void releaseOpenOrders(int account_id, int count);
+
+    // Replaces every account's open-order count, e.g. with the engine's
+    // after replaying a journal, whose orders were never checked here
+    void restoreOpenOrders(const std::unordered_map<int, int>& by_account);
+
+    // Engine events keep positions, open orders and reference prices current
+    void onFill(const Fill& fill);
+    void onCancel(const OrderCancel& cancel);
+    void onQuote(const Quote& quote);
+
+    const RiskStats& getStats() const { return stats; }
+
+private:
+    struct SymbolRisk {
+        std::string symbol;
+        int index;
+        std::atomic<double> last_trade_price{0.0};
+        std::atomic<double> mid_price{0.0};
+        std::atomic<bool> spread{false};
+    };
+
+    struct AccountRisk {
+        std::string name;
+        std::atomic<int> open_orders{0};
+        TokenBucket order_rate;
+        std::unique_ptr<std::atomic<int64_t>[]> positions;  // By SymbolRisk::index
+    };
+
+    static constexpr int SYMBOL_TABLE_SIZE = MAX_SYMBOLS * 2;  // Power of two, half full at most
+
+    RiskLimits limits;
+    RiskStats stats;
+
+    std::atomic<AccountRisk*> accounts[MAX_ACCOUNTS];
+    std::atomic<SymbolRisk*> symbol_table[SYMBOL_TABLE_SIZE];
+    int account_count;
+    int symbol_count;
+    std::mutex registry_mutex;  // Serializes inserts only; lookups never lock
+    std::function<void(int, const std::string&)> account_handler;  // Called under registry_mutex
+
+    AccountRisk* findAccount(int account_id) const;
+    SymbolRisk* findSymbol(const std::string& symbol) const;
+    SymbolRisk* getOrCreateSymbol(const std::string& symbol);
+
+    std::string checkOrderTerms(SymbolRisk* sym, double price, int quantity);
+};
+
+#endif // RISK_H
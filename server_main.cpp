@@ -1,13 +1,285 @@
 #include "trading_engine.h"
 #include "network_server.h"
+#include "metrics_server.h"
+#include "cpu_affinity.h"
+#include "numa.h"
+#include "risk.h"
+#include "shm_gateway.h"
+#include "replication.h"
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <memory>
 #include <iostream>
+#include <string>
+
+namespace {
+
+struct ServerConfig {
+    int port = 8080;
+    int metrics_port = 9100;
+    int numa_node = -1;  // Node for books; defaults to the node of the client CPUs
+    std::string shm_name;  // Shared-memory gateway segment, empty for none
+    int shm_cpu = -1;
+    std::string replicate_address;  // Where a standby may attach, empty for none
+    std::string standby_of;         // Primary to follow before serving, empty to serve at once
+    NetworkOptions network;
+};
+
+ReplicationStandby* active_standby = nullptr;
+
+void promoteStandby(int) {
+    if (active_standby) {
+        active_standby->promote();
+    }
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --port N            Client port (default 8080)\n"
+              << "  --metrics-port N    Prometheus port on 127.0.0.1 (default 9100)\n"
+              << "  --cpus LIST         Pin client threads round-robin to these CPUs, e.g. 2,4-7\n"
+              << "  --accept-cpu N      Pin the accept thread to CPU N\n"
+              << "  --spin              Busy-poll client sockets instead of blocking in recv\n"
+              << "  --busy-poll USEC    Set SO_BUSY_POLL on client sockets\n"
+              << "  --io-uring          Serve all clients from one io_uring thread (first CPU of --cpus)\n"
+              << "  --numa-node N       Allocate order books on NUMA node N\n"
+              << "  --shm NAME          Serve co-located clients through /dev/shm/NAME\n"
+              << "  --shm-cpu N         Pin the shared-memory gateway thread to CPU N (--spin makes it poll)\n"
+              << "  --session-rate N    Throttle each connection or shm client to N commands/s (CANCEL exempt)\n"
+              << "  --session-burst N   Commands a connection may send at once (default 100)\n"
+              << "  --account-rate N    Throttle each LOGON account to N commands/s across connections\n"
+              << "  --account-burst N   Commands an account may send at once (default 100)\n"
+              << "  --engine-slots N    Requests allowed in the engine at once (default: hardware threads)\n"
+              << "  --queue-depth N     Orders that may wait for the engine before more are rejected (default 256)\n"
+              << "  --heartbeat MS      Send HEARTBEAT to framed sessions silent for MS milliseconds\n"
+              << "  --idle-timeout MS   Disconnect sessions silent for MS milliseconds (default 3 heartbeats)\n"
+              << "  --replicate ADDR    Stream the engine journal to a standby on ADDR (unix:PATH, HOST:PORT or PORT)\n"
+              << "  --standby-of ADDR   Follow the primary at ADDR; serve once it goes away or on SIGUSR1\n"
+              << "  --help              Show this message" << std::endl;
+}
+
+bool parseInt(const std::string& text, int& value) {
+    try {
+        size_t used = 0;
+        value = std::stoi(text, &used);
+        return used == text.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool parseDouble(const std::string& text, double& value) {
+    try {
+        size_t used = 0;
+        value = std::stod(text, &used);
+        return used == text.size() && std::isfinite(value);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Returns false with error set if the arguments are not usable
+bool parseArgs(int argc, char* argv[], ServerConfig& config, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--spin") {
+            config.network.spin = true;
+            continue;
+        }
+        if (arg == "--io-uring") {
+            config.network.use_uring = true;
+            continue;
+        }
+
+        if (arg != "--port" && arg != "--metrics-port" && arg != "--cpus" && arg != "--accept-cpu" &&
+            arg != "--busy-poll" && arg != "--numa-node" && arg != "--shm" && arg != "--shm-cpu" &&
+            arg != "--session-rate" && arg != "--session-burst" && arg != "--account-rate" &&
+            arg != "--account-burst" && arg != "--engine-slots" && arg != "--queue-depth" &&
+            arg != "--heartbeat" && arg != "--idle-timeout" && arg != "--replicate" && arg != "--standby-of") {
+            error = "Unknown option: " + arg;
+            return false;
+        }
+        if (i + 1 == argc) {
+            error = "Missing value for " + arg;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        bool ok;
+        if (arg == "--port") {
+            ok = parseInt(value, config.port) && config.port > 0 && config.port < 65536;
+        } else if (arg == "--metrics-port") {
+            ok = parseInt(value, config.metrics_port) && config.metrics_port > 0 && config.metrics_port < 65536;
+        } else if (arg == "--cpus") {
+            ok = parseCpuList(value, config.network.client_cpus);
+        } else if (arg == "--shm") {
+            config.shm_name = value;
+            ok = !value.empty() && value.find('/', 1) == std::string::npos;
+        } else if (arg == "--shm-cpu") {
+            ok = parseInt(value, config.shm_cpu) && config.shm_cpu >= 0;
+        } else if (arg == "--replicate") {
+            config.replicate_address = value;
+            ok = !value.empty();
+        } else if (arg == "--standby-of") {
+            config.standby_of = value;
+            ok = !value.empty();
+        } else if (arg == "--numa-node") {
+            ok = parseInt(value, config.numa_node) && config.numa_node >= 0;
+        } else if (arg == "--accept-cpu") {
+            ok = parseInt(value, config.network.accept_cpu) && config.network.accept_cpu >= 0;
+        } else if (arg == "--heartbeat") {
+            ok = parseInt(value, config.network.heartbeat_ms) && config.network.heartbeat_ms >= 0;
+        } else if (arg == "--idle-timeout") {
+            ok = parseInt(value, config.network.idle_timeout_ms) && config.network.idle_timeout_ms >= 0;
+        } else if (arg == "--engine-slots") {
+            ok = parseInt(value, config.network.engine_slots) && config.network.engine_slots > 0;
+        } else if (arg == "--queue-depth") {
+            ok = parseInt(value, config.network.order_queue_depth) && config.network.order_queue_depth >= 0;
+        } else if (arg == "--session-rate") {
+            ok = parseDouble(value, config.network.session_rate) && config.network.session_rate >= 0;
+        } else if (arg == "--session-burst") {
+            ok = parseDouble(value, config.network.session_burst) && config.network.session_burst >= 1;
+        } else if (arg == "--account-rate") {
+            ok = parseDouble(value, config.network.account_rate) && config.network.account_rate >= 0;
+        } else if (arg == "--account-burst") {
+            ok = parseDouble(value, config.network.account_burst) && config.network.account_burst >= 1;
+        } else {
+            ok = parseInt(value, config.network.busy_poll_usec) && config.network.busy_poll_usec >= 0;
+        }
+        if (!ok) {
+            error = "Invalid value for " + arg + ": " + value;
+            return false;
+        }
+    }
+    if (!config.replicate_address.empty() && !config.standby_of.empty()) {
+        error = "--replicate and --standby-of cannot be combined";
+        return false;
+    }
+    return true;
+}
+
+// Node shared by all client CPUs, or -1 if they span nodes or none are set
+int nodeOfCpus(const std::vector<int>& cpus) {
+    int node = -1;
+    for (int cpu : cpus) {
+        int cpu_node = numaNodeOfCpu(cpu);
+        if (cpu_node < 0 || (node >= 0 && cpu_node != node)) {
+            return -1;
+        }
+        node = cpu_node;
+    }
+    return node;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+
+    ServerConfig config;
+    std::string error;
+    if (!parseArgs(argc, argv, config, error)) {
+        std::cerr << error << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::cout << describeNuma();
+    std::vector<NumaNode> nodes = readNumaNodes();
+    if (config.numa_node >= 0 && !nodes.empty() &&
+        std::none_of(nodes.begin(), nodes.end(), [&](const NumaNode& n) { return n.id == config.numa_node; })) {
+        std::cerr << "NUMA node " << config.numa_node << " is not online" << std::endl;
+        return 1;
+    }
+    int book_node = config.numa_node >= 0 ? config.numa_node : nodeOfCpus(config.network.client_cpus);
+    if (config.numa_node >= 0 && !config.network.client_cpus.empty() &&
+        nodeOfCpus(config.network.client_cpus) != config.numa_node) {
+        std::cout << "Warning: client CPUs are not all on NUMA node " << config.numa_node
+                  << "; books will be read across nodes" << std::endl;
+    }
+    if (book_node >= 0 && nodes.size() > 1) {
+        std::cout << "Order books allocated on NUMA node " << book_node << std::endl;
+    }
 
-int main() {
     TradingEngine engine;
-    NetworkServer server(&engine, 8080);
-    
+    engine.setBookNode(book_node);
+    RiskManager risk(RiskLimits{});
+    NetworkServer server(&engine, config.port, &risk, config.network);
+    MetricsServer metrics(&engine, &server, config.metrics_port);
+
+    ReplicationStats replication_stats;
+    ReplicationPrimary primary(replication_stats);
+    if (!config.replicate_address.empty()) {
+        if (!primary.start(config.replicate_address, error)) {
+            std::cerr << "Replication: " << error << std::endl;
+            return 1;
+        }
+        engine.setJournal([&primary](const EngineCommand& command) { primary.append(command); });
+        risk.setAccountHandler([&engine](int account_id, const std::string& name) {
+            engine.recordAccount(account_id, name);
+        });
+        metrics.setReplication(&replication_stats, true);
+        std::cout << "Replicating to standby on " << config.replicate_address << std::endl;
+    }
+
+    int last_gateway_session_id = 0;
+    if (!config.standby_of.empty()) {
+        ReplicationStandby standby(&engine, &risk, replication_stats);
+        if (!standby.connect(config.standby_of, error)) {
+            std::cerr << "Replication: " << error << std::endl;
+            return 1;
+        }
+        metrics.setReplication(&replication_stats, false);
+        metrics.start();
+
+        active_standby = &standby;
+        std::signal(SIGUSR1, promoteStandby);
+        std::cout << "Standby of " << config.standby_of << "; SIGUSR1 promotes" << std::endl;
+        bool consistent = standby.run();
+        std::signal(SIGUSR1, SIG_DFL);
+        active_standby = nullptr;
+        if (!consistent) {
+            std::cerr << "Replication: engine diverged from the primary at sequence "
+                      << replication_stats.sequence.value() + 1 << "; not serving" << std::endl;
+            return 1;
+        }
+        server.reserveSessionIds(standby.lastSessionId());
+        last_gateway_session_id = standby.lastGatewaySessionId();
+        std::cout << "Promoted at sequence " << replication_stats.sequence.value() << std::endl;
+    }
+
+    std::unique_ptr<ShmGateway> gateway;
+    if (!config.shm_name.empty()) {
+        gateway = std::make_unique<ShmGateway>(&engine, &risk, config.shm_name, config.network.spin,
+                                               config.shm_cpu);
+        server.attachGateway(gateway.get());
+        gateway->reserveSessionIds(last_gateway_session_id);
+        if (!gateway->start(error)) {
+            std::cerr << "Shared-memory gateway: " << error << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.standby_of.empty()) {
+        metrics.start();
+    }
+
+    if (config.network.spin || !config.network.client_cpus.empty() || config.network.accept_cpu >= 0) {
+        std::cout << "Latency mode: " << (config.network.spin ? "spinning" : "blocking") << " reads, "
+                  << config.network.client_cpus.size() << " client CPUs, accept CPU "
+                  << config.network.accept_cpu << ", busy poll " << config.network.busy_poll_usec << "us"
+                  << std::endl;
+    }
+
     std::cout << "Starting networked trading server...\n" << std::endl;
     server.start();
-    
+
     return 0;
-}
\ No newline at end of file
+}
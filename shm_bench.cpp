@@ -0,0 +1,98 @@
+// Round-trip latency through the shared-memory gateway: sends one order at a
+// time and times it until its ACK arrives. Orders alternate BUY/SELL at one
+// price, so every second order trades and its FILLs come back ahead of the
+// ACK, as they would for a live strategy.
+//
+// Usage: shm_bench [name] [orders] [spin_iterations]
+// name is as given to trading_server --shm; spin_iterations defaults to
+// spinning only on multi-CPU hosts.
+
+#include "shm_client.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr int WARMUP_ORDERS = 1000;
+constexpr long RESPONSE_TIMEOUT_US = 1000000;
+
+// Waits for the ACK or REJECT of tag, counting the events read on the way;
+// false on timeout
+bool awaitReply(ShmClient& client, uint64_t tag, shm::Message& reply, uint64_t& events) {
+    while (client.receive(reply, RESPONSE_TIMEOUT_US)) {
+        if ((reply.type == shm::MessageType::ACK || reply.type == shm::MessageType::REJECT) && reply.tag == tag) {
+            return true;
+        }
+        ++events;
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string name = argc > 1 ? argv[1] : "trading";
+    int orders = argc > 2 ? std::atoi(argv[2]) : 100000;
+    int spin_iterations = argc > 3 ? std::atoi(argv[3]) : shm::defaultSpinIterations();
+    if (orders <= 0 || spin_iterations < 0) {
+        std::cerr << "Usage: " << argv[0] << " [name] [orders] [spin_iterations]" << std::endl;
+        return 1;
+    }
+
+    ShmClient client(spin_iterations);
+    std::string error;
+    if (!client.connect(name, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    shm::Message reply;
+    uint64_t events = 0;
+    uint64_t tag = client.logon("", shm::FLAG_CANCEL_ON_DISCONNECT);
+    if (!awaitReply(client, tag, reply, events) || reply.type != shm::MessageType::ACK) {
+        std::cerr << "LOGON failed" << std::endl;
+        return 1;
+    }
+
+    std::vector<int64_t> samples;
+    samples.reserve(orders);
+    uint64_t rejects = 0;
+    for (int i = 0; i < WARMUP_ORDERS + orders; ++i) {
+        uint8_t side = i % 2 == 0 ? shm::SIDE_BUY : shm::SIDE_SELL;
+        auto begin = std::chrono::steady_clock::now();
+        tag = client.newOrder(side, "SHMBENCH", 100.00, 1);
+        if (tag == 0 || !awaitReply(client, tag, reply, events)) {
+            std::cerr << "no reply to order " << i << std::endl;
+            return 1;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        if (reply.type == shm::MessageType::REJECT) {
+            ++rejects;
+        }
+        if (i >= WARMUP_ORDERS) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+    client.disconnect();
+
+    std::sort(samples.begin(), samples.end());
+    double mean = 0;
+    for (int64_t sample : samples) {
+        mean += sample;
+    }
+    mean /= samples.size();
+    auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))] / 1000.0;
+    };
+
+    std::cout << "orders: " << orders << " rejects: " << rejects << " events: " << events << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "round trip us: mean " << mean / 1000.0 << " p50 " << percentile(0.50) << " p90 "
+              << percentile(0.90) << " p99 " << percentile(0.99) << " p99.9 " << percentile(0.999) << " max "
+              << samples.back() / 1000.0 << std::endl;
+    return 0;
+}
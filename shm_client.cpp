@@ -0,0 +1,165 @@
+#include "shm_client.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+constexpr auto OPEN_TIMEOUT = std::chrono::seconds(1);
+
+}
+
+ShmClient::ShmClient(int spins) : spin_iterations(spins), segment(nullptr), slot(nullptr), next_tag(1) {
+}
+
+ShmClient::~ShmClient() {
+    disconnect();
+}
+
+bool ShmClient::connect(const std::string& name, std::string& error) {
+    disconnect();
+
+    std::string path = name.empty() || name[0] != '/' ? "/" + name : name;
+    int fd = shm_open(path.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "shm_open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    void* memory = mmap(nullptr, sizeof(shm::Segment), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        error = "mmap " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    segment = static_cast<shm::Segment*>(memory);
+
+    if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != shm::MAGIC || segment->version != shm::VERSION ||
+        segment->client_count != shm::MAX_CLIENTS || segment->ring_slots != shm::RING_SLOTS) {
+        error = path + " is not a compatible gateway segment";
+        disconnect();
+        return false;
+    }
+
+    for (shm::ClientSlot& candidate : segment->clients) {
+        uint32_t expected = shm::SLOT_FREE;
+        if (candidate.state.compare_exchange_strong(expected, shm::SLOT_RESERVED, std::memory_order_acq_rel)) {
+            candidate.pid = getpid();
+            candidate.state.store(shm::SLOT_CLAIMED, std::memory_order_release);
+            slot = &candidate;
+            break;
+        }
+    }
+    if (slot == nullptr) {
+        error = "no free client slot in " + path;
+        disconnect();
+        return false;
+    }
+    shm::wakeIfSleeping(segment->gateway_sleeping);
+
+    auto deadline = std::chrono::steady_clock::now() + OPEN_TIMEOUT;
+    while (slot->state.load(std::memory_order_acquire) != shm::SLOT_OPEN) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            // Give the slot back unless the gateway opened it just now
+            uint32_t expected = shm::SLOT_CLAIMED;
+            if (slot->state.compare_exchange_strong(expected, shm::SLOT_FREE, std::memory_order_acq_rel)) {
+                slot = nullptr;
+                error = "gateway on " + path + " is not answering";
+                disconnect();
+                return false;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+void ShmClient::disconnect() {
+    if (slot != nullptr) {
+        slot->state.store(shm::SLOT_CLOSING, std::memory_order_release);
+        shm::wakeIfSleeping(segment->gateway_sleeping);
+        slot = nullptr;
+    }
+    if (segment != nullptr) {
+        munmap(segment, sizeof(shm::Segment));
+        segment = nullptr;
+    }
+    backlog.clear();
+}
+
+uint64_t ShmClient::send(shm::Message& request) {
+    if (slot == nullptr) {
+        return 0;
+    }
+    request.tag = next_tag++;
+
+    // The gateway may itself be waiting for response space, so keep reading
+    shm::Message response;
+    while (!shm::push(slot->requests, request)) {
+        if (slot->state.load(std::memory_order_acquire) != shm::SLOT_OPEN) {
+            return 0;
+        }
+        while (shm::pop(slot->responses, response)) {
+            backlog.push_back(response);
+        }
+        cpuRelax();
+    }
+    shm::wakeIfSleeping(segment->gateway_sleeping);
+    return request.tag;
+}
+
+uint64_t ShmClient::logon(const std::string& account, uint32_t flags) {
+    shm::Message request{};
+    request.type = shm::MessageType::LOGON;
+    request.flags = flags;
+    shm::setField(request.symbol, sizeof(request.symbol), account);
+    return send(request);
+}
+
+uint64_t ShmClient::newOrder(uint8_t side, const std::string& symbol, double price, int quantity,
+                             uint8_t order_type) {
+    shm::Message request{};
+    request.type = shm::MessageType::NEW_ORDER;
+    request.side = side;
+    request.order_type = order_type;
+    request.price = price;
+    request.quantity = quantity;
+    shm::setField(request.symbol, sizeof(request.symbol), symbol);
+    return send(request);
+}
+
+uint64_t ShmClient::cancel(const std::string& symbol, int order_id) {
+    shm::Message request{};
+    request.type = shm::MessageType::CANCEL;
+    request.order_id = order_id;
+    shm::setField(request.symbol, sizeof(request.symbol), symbol);
+    return send(request);
+}
+
+uint64_t ShmClient::cancelAll(const std::string& symbol) {
+    shm::Message request{};
+    request.type = shm::MessageType::CANCEL_ALL;
+    shm::setField(request.symbol, sizeof(request.symbol), symbol);
+    return send(request);
+}
+
+bool ShmClient::receive(shm::Message& message, long timeout_us) {
+    if (!backlog.empty()) {
+        message = backlog.front();
+        backlog.pop_front();
+        return true;
+    }
+    if (slot == nullptr) {
+        return false;
+    }
+    if (shm::pop(slot->responses, message)) {
+        return true;
+    }
+    shm::Ring& responses = slot->responses;
+    shm::waitFor(responses.sleeping, [&responses]() { return !shm::empty(responses); }, spin_iterations,
+                 timeout_us * 1000);
+    return shm::pop(responses, message);
+}
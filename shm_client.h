@@ -0,0 +1,48 @@
+#ifndef SHM_CLIENT_H
+#define SHM_CLIENT_H
+
+#include "shm_protocol.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Client end of the shared-memory gateway for strategies on the server's
+// host. Not thread-safe: one thread sends and receives.
+class ShmClient {
+public:
+    // spin_iterations: polls of an empty ring before sleeping on its futex
+    explicit ShmClient(int spin_iterations = shm::defaultSpinIterations());
+    ~ShmClient();
+
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    // Attaches to the gateway segment name (as given to --shm) and claims a
+    // client slot; false with error set if none is free or the server is
+    // not answering
+    bool connect(const std::string& name, std::string& error);
+    void disconnect();
+    bool connected() const { return slot != nullptr; }
+
+    // Each returns the request's tag, echoed in its ACK or REJECT, or 0 if
+    // not connected
+    uint64_t logon(const std::string& account, uint32_t flags = 0);
+    uint64_t newOrder(uint8_t side, const std::string& symbol, double price, int quantity,
+                      uint8_t order_type = shm::ORDER_LIMIT);
+    uint64_t cancel(const std::string& symbol, int order_id);
+    uint64_t cancelAll(const std::string& symbol = "");
+
+    // Next message from the gateway; false if none arrives within timeout_us
+    bool receive(shm::Message& message, long timeout_us);
+
+private:
+    int spin_iterations;
+    shm::Segment* segment;
+    shm::ClientSlot* slot;
+    uint64_t next_tag;
+    std::deque<shm::Message> backlog;  // Responses read while waiting for request space
+
+    uint64_t send(shm::Message& request);
+};
+
+#endif // SHM_CLIENT_H
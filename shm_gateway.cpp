@@ -0,0 +1,391 @@
+#include "shm_gateway.h"
+#include "logger.h"
+#include "cpu_affinity.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace {
+
+constexpr long IDLE_TIMEOUT_NS = 100000000;      // Bounds a sleep so dead clients are still reaped
+constexpr int MAX_REQUESTS_PER_TURN = 64;        // Keeps one busy client from starving the rest
+constexpr auto REAP_INTERVAL = std::chrono::seconds(1);
+
+bool processAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// Engine replies end in a newline; REJECT text carries the first line
+void setText(shm::Message& message, const std::string& text) {
+    size_t end = text.find('\n');
+    shm::setField(message.text, sizeof(message.text), text.substr(0, end));
+}
+
+}
+
+ShmGateway::ShmGateway(TradingEngine* eng, RiskManager* rm, const std::string& n, bool s, int c)
+    : engine(eng), risk(rm), name(n), spin(s), cpu(c), segment(nullptr), running(false), next_sequence(0),
+      last_reap(std::chrono::steady_clock::now()) {
+    if (name.empty() || name[0] != '/') {
+        name = "/" + name;
+    }
+}
+
+ShmGateway::~ShmGateway() {
+    stop();
+    if (segment != nullptr) {
+        munmap(segment, sizeof(shm::Segment));
+        shm_unlink(name.c_str());
+    }
+}
+
+bool ShmGateway::start(std::string& error) {
+    // Clients of an earlier server on this name are gone with it
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        error = "shm_open " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(shm::Segment)) != 0) {
+        error = "ftruncate " + name + ": " + std::strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory = mmap(nullptr, sizeof(shm::Segment), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        error = "mmap " + name + ": " + std::strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // A new file reads as zeros: every slot FREE and every ring empty.
+    // magic goes last so clients never see a half-made segment.
+    segment = static_cast<shm::Segment*>(memory);
+    segment->version = shm::VERSION;
+    segment->client_count = shm::MAX_CLIENTS;
+    segment->ring_slots = shm::RING_SLOTS;
+    __atomic_store_n(&segment->magic, shm::MAGIC, __ATOMIC_RELEASE);
+
+    running = true;
+    thread = std::thread(&ShmGateway::run, this);
+    LOG_INFO("[GATEWAY] Shared-memory gateway on /dev/shm{} ({} client slots)", name, shm::MAX_CLIENTS);
+    return true;
+}
+
+void ShmGateway::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    shm::wakeIfSleeping(segment->gateway_sleeping);
+    thread.join();
+    for (uint32_t i = 0; i < shm::MAX_CLIENTS; ++i) {
+        if (clients[i].session_id != 0) {
+            closeClient(i);
+        }
+    }
+}
+
+void ShmGateway::run() {
+    if (cpu >= 0 && !pinCurrentThread(cpu)) {
+        LOG_WARN("[GATEWAY] Could not pin the gateway thread to CPU {}", cpu);
+    }
+
+    int spin_iterations = shm::defaultSpinIterations();  // Before sleeping, when not in spin mode
+    shm::Message request;
+    while (running) {
+        bool busy = false;
+        for (uint32_t i = 0; i < shm::MAX_CLIENTS; ++i) {
+            shm::ClientSlot& slot = segment->clients[i];
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (state == shm::SLOT_CLAIMED) {
+                openClient(i);
+                busy = true;
+            } else if (state == shm::SLOT_CLOSING) {
+                closeClient(i);
+                busy = true;
+            } else if (state == shm::SLOT_OPEN) {
+                for (int n = 0; n < MAX_REQUESTS_PER_TURN && shm::pop(slot.requests, request); ++n) {
+                    handleRequest(i, request);
+                    busy = true;
+                }
+            }
+        }
+        if (busy) {
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() - last_reap >= REAP_INTERVAL) {
+            reapDeadClients();
+        }
+        if (spin) {
+            cpuRelax();
+        } else {
+            shm::waitFor(segment->gateway_sleeping, [this]() { return !running || hasWork(); },
+                         spin_iterations, IDLE_TIMEOUT_NS);
+        }
+    }
+}
+
+bool ShmGateway::hasWork() const {
+    for (uint32_t i = 0; i < shm::MAX_CLIENTS; ++i) {
+        const shm::ClientSlot& slot = segment->clients[i];
+        uint32_t state = slot.state.load(std::memory_order_acquire);
+        if (state == shm::SLOT_CLAIMED || state == shm::SLOT_CLOSING ||
+            (state == shm::SLOT_OPEN && !shm::empty(slot.requests))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmGateway::openClient(uint32_t index) {
+    Client& client = clients[index];
+    {
+        std::lock_guard<std::mutex> lock(client.send_mutex);
+        int sequence = next_sequence++ % (SESSION_ID_BASE / shm::MAX_CLIENTS);
+        client.session_id = SESSION_ID_BASE + sequence * static_cast<int>(shm::MAX_CLIENTS) +
+                            static_cast<int>(index);
+        client.account_id = RiskManager::DEFAULT_ACCOUNT;
+        client.has_orders = false;
+        client.cancel_on_disconnect = false;
+        client.stp_mode = StpMode::CANCEL_NEWEST;
+        client.rate_limit.configure(limits.client_rate, limits.client_burst);
+    }
+    LOG_INFO("[GATEWAY] Client pid {} attached on slot {}", segment->clients[index].pid, index);
+    segment->clients[index].state.store(shm::SLOT_OPEN, std::memory_order_release);
+}
+
+void ShmGateway::closeClient(uint32_t index) {
+    Client& client = clients[index];
+    shm::ClientSlot& slot = segment->clients[index];
+
+    // Stop deliveries first, so the cancels below are not queued to a
+    // client that has stopped reading
+    int session_id;
+    {
+        std::lock_guard<std::mutex> lock(client.send_mutex);
+        session_id = client.session_id;
+        client.session_id = 0;
+    }
+    if (session_id != 0 && client.cancel_on_disconnect) {
+        enterEngine(AdmissionQueue::CANCEL);
+        int cancelled = engine->cancelAll(session_id);
+        leaveEngine();
+        LOG_INFO("[GATEWAY] Cancelled {} orders for slot {} on disconnect", cancelled, index);
+    }
+    LOG_INFO("[GATEWAY] Client pid {} detached from slot {}", slot.pid, index);
+
+    std::lock_guard<std::mutex> lock(client.send_mutex);
+    for (shm::Ring* ring : {&slot.requests, &slot.responses}) {
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+        ring->sleeping.store(0, std::memory_order_relaxed);
+    }
+    slot.pid = 0;
+    slot.state.store(shm::SLOT_FREE, std::memory_order_release);
+}
+
+void ShmGateway::reapDeadClients() {
+    last_reap = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < shm::MAX_CLIENTS; ++i) {
+        shm::ClientSlot& slot = segment->clients[i];
+        if (slot.state.load(std::memory_order_acquire) == shm::SLOT_OPEN && !processAlive(slot.pid)) {
+            LOG_INFO("[GATEWAY] Client pid {} on slot {} has exited", slot.pid, i);
+            closeClient(i);
+        }
+    }
+}
+
+bool ShmGateway::deliver(uint32_t index, int session_id, const shm::Message& message) {
+    Client& client = clients[index];
+    shm::ClientSlot& slot = segment->clients[index];
+    std::lock_guard<std::mutex> lock(client.send_mutex);
+
+    // The client library drains responses while its own request ring is
+    // full, so waiting here cannot deadlock against a live client
+    int polls = 0;
+    while (client.session_id == session_id && !shm::push(slot.responses, message)) {
+        if (slot.state.load(std::memory_order_acquire) != shm::SLOT_OPEN ||
+            (++polls % 1024 == 0 && !processAlive(slot.pid))) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    if (client.session_id != session_id) {
+        return false;
+    }
+    shm::wakeIfSleeping(slot.responses.sleeping);
+    return true;
+}
+
+void ShmGateway::onFill(const Fill& fill) {
+    shm::Message event{};
+    event.type = shm::MessageType::FILL;
+    event.side = fill.side == OrderSide::BUY ? shm::SIDE_BUY : shm::SIDE_SELL;
+    event.price = fill.price;
+    event.quantity = fill.quantity;
+    event.order_id = fill.order_id;
+    event.remaining = fill.remaining;
+    shm::setField(event.symbol, sizeof(event.symbol), fill.symbol);
+    deliver((fill.session_id - SESSION_ID_BASE) % shm::MAX_CLIENTS, fill.session_id, event);
+}
+
+void ShmGateway::onCancel(const OrderCancel& cancel) {
+    shm::Message event{};
+    event.type = shm::MessageType::CANCELED;
+    event.side = cancel.side == OrderSide::BUY ? shm::SIDE_BUY : shm::SIDE_SELL;
+    event.price = cancel.price;
+    event.quantity = cancel.quantity;
+    event.order_id = cancel.order_id;
+    event.remaining = cancel.remaining;
+    shm::setField(event.symbol, sizeof(event.symbol), cancel.symbol);
+    deliver((cancel.session_id - SESSION_ID_BASE) % shm::MAX_CLIENTS, cancel.session_id, event);
+}
+
+void ShmGateway::handleRequest(uint32_t index, const shm::Message& request) {
+    Client& client = clients[index];
+    shm::Message reply{};
+    reply.type = shm::MessageType::ACK;
+    reply.tag = request.tag;
+    auto reject = [&reply](const std::string& reason) {
+        reply.type = shm::MessageType::REJECT;
+        setText(reply, reason);
+    };
+
+    if (!admitRequest(client, request)) {
+        if (limits.throttled) {
+            limits.throttled->add();
+        }
+        reject("ERROR: Throttled: command rate limit exceeded");
+        deliver(index, client.session_id, reply);
+        return;
+    }
+
+    // Same lanes as TCP: an order is shed when the engine is saturated, a
+    // cancel always gets in
+    bool uses_engine = request.type == shm::MessageType::NEW_ORDER || request.type == shm::MessageType::CANCEL ||
+                       request.type == shm::MessageType::CANCEL_ALL;
+    AdmissionQueue::Lane lane = request.type == shm::MessageType::NEW_ORDER ? AdmissionQueue::ORDER
+                                                                            : AdmissionQueue::CANCEL;
+    if (uses_engine && !enterEngine(lane)) {
+        reject("ERROR: Server busy: order queue full");
+        deliver(index, client.session_id, reply);
+        return;
+    }
+
+    std::string symbol = shm::getField(request.symbol, sizeof(request.symbol));
+
+    switch (request.type) {
+    case shm::MessageType::LOGON: {
+        // An empty account only sets the flags
+        if (!symbol.empty()) {
+            if (!risk) {
+                reject("ERROR: Accounts are not enabled on this server");
+                break;
+            }
+            if (client.has_orders) {
+                reject("ERROR: LOGON must come before the first order");
+                break;
+            }
+            int account_id = risk->registerAccount(symbol);
+            if (account_id < 0) {
+                reject("ERROR: Account limit reached");
+                break;
+            }
+            client.account_id = account_id;
+        }
+        client.cancel_on_disconnect = request.flags & shm::FLAG_CANCEL_ON_DISCONNECT;
+        break;
+    }
+    case shm::MessageType::NEW_ORDER: {
+        if (request.side != shm::SIDE_BUY && request.side != shm::SIDE_SELL) {
+            reject("ERROR: Invalid side. Use BUY or SELL");
+            break;
+        }
+        if (request.order_type != shm::ORDER_LIMIT && request.order_type != shm::ORDER_FILL_OR_KILL) {
+            reject("ERROR: Invalid order type");
+            break;
+        }
+        if (symbol.empty() || !(request.price > 0) || request.quantity <= 0) {
+            reject("ERROR: Price and quantity must be positive");
+            break;
+        }
+        OrderSide side = request.side == shm::SIDE_BUY ? OrderSide::BUY : OrderSide::SELL;
+
+        if (risk) {
+            std::string refusal = risk->checkNewOrder(client.account_id, symbol, side, request.price,
+                                                      request.quantity);
+            if (!refusal.empty()) {
+                reject(refusal);
+                break;
+            }
+        }
+
+        client.has_orders = true;
+        int order_id = 0;
+        std::string result = request.order_type == shm::ORDER_FILL_OR_KILL
+            ? engine->addFillOrKillOrder(symbol, side, request.price, request.quantity, client.session_id,
+                                         client.account_id, client.stp_mode, &order_id)
+            : engine->addOrder(symbol, side, request.price, request.quantity, client.session_id,
+                               client.account_id, client.stp_mode, &order_id);
+        reply.order_id = order_id;
+        if (result.compare(0, 6, "ERROR:") == 0) {
+            reject(result);
+        }
+        break;
+    }
+    case shm::MessageType::CANCEL: {
+        reply.order_id = request.order_id;
+        std::string result = engine->cancelOrder(symbol, request.order_id, client.session_id);
+        if (result.compare(0, 6, "ERROR:") == 0) {
+            reject(result);
+        }
+        break;
+    }
+    case shm::MessageType::CANCEL_ALL:
+        reply.quantity = engine->cancelAll(client.session_id, symbol);
+        break;
+    default:
+        reject("ERROR: Unknown message type");
+        break;
+    }
+    if (uses_engine) {
+        leaveEngine();
+    }
+
+    deliver(index, client.session_id, reply);
+}
+
+void ShmGateway::reserveSessionIds(int last) {
+    if (ownsSession(last)) {
+        next_sequence = std::max(next_sequence, (last - SESSION_ID_BASE) / static_cast<int>(shm::MAX_CLIENTS) + 1);
+    }
+}
+
+bool ShmGateway::admitRequest(Client& client, const shm::Message& request) {
+    // A single-order cancel is never throttled, as over TCP
+    if (request.type == shm::MessageType::CANCEL) {
+        return true;
+    }
+    if (!client.rate_limit.tryConsume()) {
+        return false;
+    }
+    return !limits.account_limits || client.account_id == RiskManager::DEFAULT_ACCOUNT ||
+           limits.account_limits[client.account_id].tryConsume();
+}
+
+bool ShmGateway::enterEngine(AdmissionQueue::Lane lane) {
+    return !limits.admission || limits.admission->tryEnter(lane);
+}
+
+void ShmGateway::leaveEngine() {
+    if (limits.admission) {
+        limits.admission->leave();
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef SHM_GATEWAY_H
+#define SHM_GATEWAY_H
+
+#include "trading_engine.h"
+#include "risk.h"
+#include "shm_protocol.h"
+#include "admission_queue.h"
+#include "token_bucket.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Serves co-located clients over the shared-memory transport in
+// shm_protocol.h. One thread polls every client's request ring and makes the
+// same engine and risk calls NetworkServer makes for TCP sessions. Fills and
+// cancels reach it through NetworkServer, which owns the engine's event
+// handlers (see NetworkServer::attachGateway).
+class ShmGateway {
+public:
+    // Gateway session IDs start here, clear of TCP session IDs; the low bits
+    // name the client slot
+    static constexpr int SESSION_ID_BASE = 1 << 30;
+
+    // The limits TCP commands meet, applied to gateway requests as well.
+    // A client slot is throttled like a connection; engine slots are only
+    // ever tried, since one thread serves every client.
+    struct Limits {
+        AdmissionQueue* admission = nullptr;
+        TokenBucket* account_limits = nullptr;  // By account ID, null for none
+        ShardedCounter* throttled = nullptr;
+        double client_rate = 0.0;
+        double client_burst = 100.0;
+    };
+
+    // name is the segment under /dev/shm. spin keeps the polling thread on
+    // its CPU instead of sleeping when every ring is empty; cpu pins it, -1
+    // for none.
+    ShmGateway(TradingEngine* eng, RiskManager* rm, const std::string& name, bool spin, int cpu);
+    ~ShmGateway();
+
+    // Creates the segment and starts the polling thread
+    bool start(std::string& error);
+    void stop();
+
+    // Not synchronized with the polling thread; call before start()
+    void setLimits(const Limits& l) { limits = l; }
+
+    bool ownsSession(int session_id) const { return session_id >= SESSION_ID_BASE; }
+
+    // Numbers new clients' sessions above last, so orders replayed from a
+    // primary keep owners no new client can be mistaken for; call before
+    // start()
+    void reserveSessionIds(int last);
+    void onFill(const Fill& fill);
+    void onCancel(const OrderCancel& cancel);
+
+private:
+    // Gateway-side state of a client slot
+    struct Client {
+        int session_id = 0;  // 0 while the slot is not open
+        int account_id = RiskManager::DEFAULT_ACCOUNT;
+        bool has_orders = false;
+        bool cancel_on_disconnect = false;
+        StpMode stp_mode = StpMode::CANCEL_NEWEST;
+        TokenBucket rate_limit;  // Reset when a client attaches
+        std::mutex send_mutex;  // Events come from whichever thread matched against the client
+    };
+
+    TradingEngine* engine;
+    RiskManager* risk;
+    std::string name;
+    bool spin;
+    int cpu;
+    shm::Segment* segment;
+    std::atomic<bool> running;
+    std::thread thread;
+    int next_sequence;
+    Client clients[shm::MAX_CLIENTS];
+    std::chrono::steady_clock::time_point last_reap;
+    Limits limits;
+
+    void run();
+    bool hasWork() const;
+    void openClient(uint32_t index);
+    void closeClient(uint32_t index);
+    void reapDeadClients();
+    void handleRequest(uint32_t index, const shm::Message& request);
+    bool admitRequest(Client& client, const shm::Message& request);
+    bool enterEngine(AdmissionQueue::Lane lane);
+    void leaveEngine();
+
+    // Queues a message for the client, waiting while its ring is full; false
+    // if the client went away first
+    bool deliver(uint32_t index, int session_id, const shm::Message& message);
+};
+
+#endif // SHM_GATEWAY_H
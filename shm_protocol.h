@@ -0,0 +1,181 @@
+#ifndef SHM_PROTOCOL_H
+#define SHM_PROTOCOL_H
+
+#include "cpu_affinity.h"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Shared-memory transport between trading_server and clients on the same
+// host. The server creates /dev/shm/<name> holding a fixed number of client
+// slots; each slot is a pair of single-producer/single-consumer rings of
+// fixed-size binary messages. Both sides poll their ring and, after spinning
+// for a while, sleep on a futex in the ring that the producer wakes.
+//
+// Slot lifecycle: a client reserves a FREE slot (CAS to RESERVED), records
+// its pid, sets CLAIMED and rings the gateway doorbell; the gateway opens a
+// session and marks it OPEN. Setting CLOSING hands it back; the gateway
+// cancels if asked, resets the rings and marks it FREE. Slots of clients
+// whose process has died are reclaimed.
+
+namespace shm {
+
+constexpr uint32_t MAGIC = 0x54524757;  // "TRGW"
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t RING_SLOTS = 1024;   // Messages per ring, a power of two
+constexpr uint32_t MAX_CLIENTS = 16;
+
+enum class MessageType : uint16_t {
+    // Client to gateway
+    LOGON = 1,      // symbol holds the account; flags may set CANCEL_ON_DISCONNECT
+    NEW_ORDER,      // side, symbol, price, quantity, order_type
+    CANCEL,         // symbol, order_id
+    CANCEL_ALL,     // symbol, or empty for every book
+
+    // Gateway to client
+    ACK = 16,       // tag of the request; order_id of a new or cancelled order,
+                    // quantity holds the count for CANCEL_ALL
+    REJECT,         // tag of the request; text holds the reason
+    FILL,           // order_id, side, symbol, price, quantity, remaining
+    CANCELED,       // order_id, side, symbol, price, quantity, remaining
+};
+
+enum : uint8_t { SIDE_BUY = 0, SIDE_SELL = 1 };
+enum : uint8_t { ORDER_LIMIT = 0, ORDER_FILL_OR_KILL = 1 };
+enum : uint32_t { FLAG_CANCEL_ON_DISCONNECT = 1 };
+
+// One message in either direction, two cache lines
+struct alignas(64) Message {
+    MessageType type;
+    uint8_t side;
+    uint8_t order_type;
+    uint32_t flags;
+    uint64_t tag;         // Client's correlation ID, echoed in ACK and REJECT
+    double price;
+    int32_t quantity;
+    int32_t order_id;
+    int32_t remaining;
+    int32_t reserved;
+    char symbol[16];      // NUL-terminated unless all 16 bytes are used
+    char text[72];        // REJECT reason, truncated
+};
+static_assert(sizeof(Message) == 128, "Message layout is part of the protocol");
+
+inline void setField(char* field, size_t size, const std::string& value) {
+    size_t n = value.size() < size ? value.size() : size;
+    std::memcpy(field, value.data(), n);
+    if (n < size) {
+        field[n] = '\0';
+    }
+}
+
+inline std::string getField(const char* field, size_t size) {
+    return std::string(field, strnlen(field, size));
+}
+
+// Single-producer/single-consumer ring. head and tail only grow; the
+// consumer sets sleeping before a futex wait so the producer knows to wake it.
+struct Ring {
+    alignas(64) std::atomic<uint64_t> tail;     // Written by the producer
+    alignas(64) std::atomic<uint64_t> head;     // Written by the consumer
+    alignas(64) std::atomic<uint32_t> sleeping;
+    Message slots[RING_SLOTS];
+};
+
+enum SlotState : uint32_t { SLOT_FREE = 0, SLOT_RESERVED, SLOT_CLAIMED, SLOT_OPEN, SLOT_CLOSING };
+
+struct ClientSlot {
+    alignas(64) std::atomic<uint32_t> state;
+    int32_t pid;          // Client process, for reclaiming slots of dead clients
+    Ring requests;        // Client to gateway
+    Ring responses;       // Gateway to client
+};
+
+struct Segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t client_count;
+    uint32_t ring_slots;
+    alignas(64) std::atomic<uint32_t> gateway_sleeping;  // Doorbell for all request rings
+    ClientSlot clients[MAX_CLIENTS];
+};
+
+// Futexes live in MAP_SHARED memory, so no FUTEX_PRIVATE_FLAG
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, long timeout_ns) {
+    struct timespec timeout = {timeout_ns / 1000000000, timeout_ns % 1000000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+inline void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Wakes a consumer that went to sleep on word; call after publishing
+inline void wakeIfSleeping(std::atomic<uint32_t>& word) {
+    // Orders the publish before the check; pairs with the fence in waitFor
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (word.load(std::memory_order_relaxed) != 0) {
+        word.store(0, std::memory_order_relaxed);
+        futexWake(word);
+    }
+}
+
+// Default polls of an empty ring before sleeping. With one CPU the producer
+// cannot run while the consumer spins, so go straight to the futex.
+inline int defaultSpinIterations() {
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 100000 : 0;
+}
+
+// Spins up to spin_iterations polling ready(), then sleeps on word until a
+// producer wakes it or timeout_ns passes. Returns ready().
+template <typename Ready>
+bool waitFor(std::atomic<uint32_t>& word, Ready ready, int spin_iterations, long timeout_ns) {
+    for (int i = 0; i < spin_iterations; ++i) {
+        if (ready()) {
+            return true;
+        }
+        cpuRelax();
+    }
+    word.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready()) {
+        futexWait(word, 1, timeout_ns);
+    }
+    word.store(0, std::memory_order_relaxed);
+    return ready();
+}
+
+inline bool push(Ring& ring, const Message& message) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) == RING_SLOTS) {
+        return false;
+    }
+    ring.slots[tail & (RING_SLOTS - 1)] = message;
+    ring.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool pop(Ring& ring, Message& message) {
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head == ring.tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    message = ring.slots[head & (RING_SLOTS - 1)];
+    ring.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool empty(const Ring& ring) {
+    return ring.head.load(std::memory_order_relaxed) == ring.tail.load(std::memory_order_acquire);
+}
+
+}
+
+#endif // SHM_PROTOCOL_H
@@ -0,0 +1,189 @@
+#include "spread.h"
+#include <algorithm>
+
+namespace {
+
+// Prices implied by sums and differences are compared with this much slack,
+// so that 150.10 - 149.95 meets a spread order at 0.15
+constexpr double PRICE_EPSILON = 1e-9;
+
+bool hasBid(const Quote& quote) {
+    return quote.bid_quantity > 0;
+}
+
+bool hasAsk(const Quote& quote) {
+    return quote.ask_quantity > 0;
+}
+
+OrderSide opposite(OrderSide side) {
+    return side == OrderSide::BUY ? OrderSide::SELL : OrderSide::BUY;
+}
+
+}
+
+Spread::Spread(const std::string& symbol, OrderBook* book, const std::string& buy_leg, OrderBook* buy_book,
+               const std::string& sell_leg, OrderBook* sell_book, const MarketEventHandlers* h)
+    : names{symbol, buy_leg, sell_leg}, books{book, buy_book, sell_book}, handlers(h) {
+    for (int i = 0; i < BOOKS; ++i) {
+        seen[i].symbol = names[i];
+        implied[i].symbol = names[i];
+        implied[i].spread = symbol;
+    }
+}
+
+bool Spread::update(const std::string& changed) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+
+    bool moved = false;
+    for (int i = 0; i < BOOKS; ++i) {
+        Quote current = seen[i];
+        books[i]->readQuote(current);
+        if (!(current == seen[i])) {
+            seen[i] = current;
+            moved = true;
+        }
+    }
+    if (!moved) {
+        return false;
+    }
+
+    bool traded = false;
+    if (crossed()) {
+        int aggressor = changed == names[BUY_LEG] ? BUY_LEG : changed == names[SELL_LEG] ? SELL_LEG : SPREAD;
+        traded = matchImplied(aggressor);
+        for (int i = 0; i < BOOKS; ++i) {
+            books[i]->readQuote(seen[i]);
+        }
+    }
+
+    publishImpliedQuotes();
+    return traded;
+}
+
+bool Spread::crossed() const {
+    const Quote& spread = seen[SPREAD];
+    const Quote& buy = seen[BUY_LEG];
+    const Quote& sell = seen[SELL_LEG];
+
+    // A spread bid against buy_leg's ask and sell_leg's bid, and the mirror
+    return (hasBid(spread) && hasAsk(buy) && hasBid(sell) &&
+            spread.bid_price >= buy.ask_price - sell.bid_price - PRICE_EPSILON) ||
+           (hasAsk(spread) && hasBid(buy) && hasAsk(sell) &&
+            spread.ask_price <= buy.bid_price - sell.ask_price + PRICE_EPSILON);
+}
+
+bool Spread::matchImplied(int aggressor) {
+    // std::lock takes the three in an order that cannot deadlock with another
+    // spread sharing a leg
+    std::unique_lock<std::mutex> spread_lock(books[SPREAD]->bookMutex(), std::defer_lock);
+    std::unique_lock<std::mutex> buy_lock(books[BUY_LEG]->bookMutex(), std::defer_lock);
+    std::unique_lock<std::mutex> sell_lock(books[SELL_LEG]->bookMutex(), std::defer_lock);
+    std::lock(spread_lock, buy_lock, sell_lock);
+
+    bool traded = false;
+    while (true) {
+        // side is the spread order's; the spread buyer buys buy_leg from its
+        // best ask and sells sell_leg to its best bid
+        OrderSide side = OrderSide::BUY;
+        auto spread = books[SPREAD]->bestOrder(OrderSide::BUY);
+        auto buy = books[BUY_LEG]->bestOrder(OrderSide::SELL);
+        auto sell = books[SELL_LEG]->bestOrder(OrderSide::BUY);
+        if (!spread || !buy || !sell || spread->price < buy->price - sell->price - PRICE_EPSILON) {
+            side = OrderSide::SELL;
+            spread = books[SPREAD]->bestOrder(OrderSide::SELL);
+            buy = books[BUY_LEG]->bestOrder(OrderSide::BUY);
+            sell = books[SELL_LEG]->bestOrder(OrderSide::SELL);
+            if (!spread || !buy || !sell || spread->price > buy->price - sell->price + PRICE_EPSILON) {
+                break;
+            }
+        }
+
+        double spread_price = spread->price;
+        double buy_price = buy->price;
+        double sell_price = sell->price;
+        switch (aggressor) {
+            case SPREAD:
+                spread_price = buy_price - sell_price;
+                break;
+            case BUY_LEG:
+                buy_price = spread_price + sell_price;
+                break;
+            default:
+                sell_price = buy_price - spread_price;
+                break;
+        }
+
+        int quantity = std::min({spread->quantity, buy->quantity, sell->quantity});
+        books[SPREAD]->fillBest(side, spread_price, quantity);
+        books[BUY_LEG]->fillBest(opposite(side), buy_price, quantity);
+        books[SELL_LEG]->fillBest(side, sell_price, quantity);
+        traded = true;
+    }
+
+    BookEvents events[BOOKS];
+    if (traded) {
+        for (int i = 0; i < BOOKS; ++i) {
+            books[i]->finishImplied(events[i]);
+        }
+    }
+
+    spread_lock.unlock();
+    buy_lock.unlock();
+    sell_lock.unlock();
+
+    for (int i = 0; i < BOOKS; ++i) {
+        books[i]->publishImplied(events[i]);
+    }
+    return traded;
+}
+
+void Spread::publishImpliedQuotes() {
+    const Quote& spread = seen[SPREAD];
+    const Quote& buy = seen[BUY_LEG];
+    const Quote& sell = seen[SELL_LEG];
+
+    Quote quotes[BOOKS] = {implied[SPREAD], implied[BUY_LEG], implied[SELL_LEG]};
+    for (Quote& quote : quotes) {
+        quote.bid_price = quote.ask_price = 0.0;
+        quote.bid_quantity = quote.ask_quantity = 0;
+    }
+
+    // Into the spread from the two legs
+    if (hasBid(buy) && hasAsk(sell)) {
+        quotes[SPREAD].bid_price = buy.bid_price - sell.ask_price;
+        quotes[SPREAD].bid_quantity = std::min(buy.bid_quantity, sell.ask_quantity);
+    }
+    if (hasAsk(buy) && hasBid(sell)) {
+        quotes[SPREAD].ask_price = buy.ask_price - sell.bid_price;
+        quotes[SPREAD].ask_quantity = std::min(buy.ask_quantity, sell.bid_quantity);
+    }
+
+    // Into each leg from the spread and the other leg
+    if (hasBid(spread) && hasBid(sell)) {
+        quotes[BUY_LEG].bid_price = spread.bid_price + sell.bid_price;
+        quotes[BUY_LEG].bid_quantity = std::min(spread.bid_quantity, sell.bid_quantity);
+    }
+    if (hasAsk(spread) && hasAsk(sell)) {
+        quotes[BUY_LEG].ask_price = spread.ask_price + sell.ask_price;
+        quotes[BUY_LEG].ask_quantity = std::min(spread.ask_quantity, sell.ask_quantity);
+    }
+    if (hasBid(buy) && hasAsk(spread)) {
+        quotes[SELL_LEG].bid_price = buy.bid_price - spread.ask_price;
+        quotes[SELL_LEG].bid_quantity = std::min(buy.bid_quantity, spread.ask_quantity);
+    }
+    if (hasAsk(buy) && hasBid(spread)) {
+        quotes[SELL_LEG].ask_price = buy.ask_price - spread.bid_price;
+        quotes[SELL_LEG].ask_quantity = std::min(buy.ask_quantity, spread.bid_quantity);
+    }
+
+    for (int i = 0; i < BOOKS; ++i) {
+        if (!(quotes[i] == implied[i])) {
+            implied[i] = quotes[i];
+            if (handlers && handlers->on_quote) {
+                BookEvents events;
+                events.quote = implied[i];
+                publishBookEvents(*handlers, events);
+            }
+        }
+    }
+}
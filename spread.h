@@ -0,0 +1,56 @@
+#ifndef SPREAD_H
+#define SPREAD_H
+
+#include "trading_engine.h"
+#include <mutex>
+#include <string>
+
+// A spread instrument: buying one lot buys one lot of buy_leg and sells one
+// of sell_leg, and its price is buy_leg's minus sell_leg's, so it may be
+// zero or negative. Spread orders rest in the spread's own book and match
+// there as usual. They also trade against the legs:
+//
+//   implied in:  the legs' bid and ask imply a spread price, e.g. a spread
+//                bid at or above buy_leg's ask minus sell_leg's bid buys
+//                buy_leg and sells sell_leg at those prices
+//   implied out: a spread order and one leg imply a price in the other leg,
+//                e.g. buy_leg's implied bid is the spread bid plus
+//                sell_leg's bid
+//
+// Both are the same three-book cross seen from different books, so one
+// check covers them. Whichever book moved last is the aggressor and takes
+// the price implied by the other two; they trade at their own prices.
+class Spread {
+public:
+    Spread(const std::string& symbol, OrderBook* book, const std::string& buy_leg, OrderBook* buy_book,
+           const std::string& sell_leg, OrderBook* sell_book, const MarketEventHandlers* handlers);
+
+    const std::string& symbol() const { return names[SPREAD]; }
+    const std::string& buyLeg() const { return names[BUY_LEG]; }
+    const std::string& sellLeg() const { return names[SELL_LEG]; }
+
+    // Called after an operation on changed, the spread's book or a leg's.
+    // Reads the three tops of book without locking and does nothing more
+    // if none moved since the last call; otherwise trades any cross,
+    // locking just these three books, and publishes the implied quotes that
+    // changed. Returns whether anything traded, which moves the legs for
+    // other spreads on them.
+    bool update(const std::string& changed);
+
+private:
+    enum { SPREAD, BUY_LEG, SELL_LEG, BOOKS };
+
+    std::string names[BOOKS];
+    OrderBook* books[BOOKS];
+    const MarketEventHandlers* handlers;
+
+    std::mutex update_mutex;    // One update at a time; taken before any book_mutex
+    Quote seen[BOOKS];          // Tops of book at the last update
+    Quote implied[BOOKS];       // Implied quotes last published, by the book they imply into
+
+    bool crossed() const;
+    bool matchImplied(int aggressor);  // Trades crosses until none is left
+    void publishImpliedQuotes();
+};
+
+#endif // SPREAD_H
@@ -0,0 +1,70 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hashed timing wheel: a timer lands in the slot for its deadline tick, so
+// scheduling is a push_back and each tick looks at one slot. Timers further
+// out than one revolution share slots with nearer ones and are kept until
+// their own tick comes round. There is no cancel; owners check on expiry
+// whether the timer still matters. Not synchronized.
+template <typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(Clock::duration tick, size_t slot_count)
+        : tick(tick), origin(Clock::now()), cursor(0), slots(slot_count) {}
+
+    Clock::duration tickLength() const { return tick; }
+
+    void schedule(T value, Clock::time_point deadline) {
+        // Rounded up so a timer never fires early, and at least one tick out
+        uint64_t at = deadline > origin ? static_cast<uint64_t>((deadline - origin + tick - Clock::duration(1)) / tick) : 0;
+        at = std::max(at, cursor + 1);
+        slots[at % slots.size()].push_back(Timer{std::move(value), at});
+    }
+
+    // Calls expire(value) for every timer due by now, in tick order. expire
+    // may schedule more timers.
+    template <typename F>
+    void advance(Clock::time_point now, F&& expire) {
+        uint64_t target = now > origin ? static_cast<uint64_t>((now - origin) / tick) : 0;
+        while (cursor < target) {
+            ++cursor;
+            std::vector<Timer>& slot = slots[cursor % slots.size()];
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].at > cursor) {
+                    ++i;
+                    continue;
+                }
+                due.push_back(std::move(slot[i].value));
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+            }
+            // Fired outside the slot so expire can schedule into it
+            for (T& value : due) {
+                expire(value);
+            }
+            due.clear();
+        }
+    }
+
+private:
+    struct Timer {
+        T value;
+        uint64_t at;  // Tick the timer is due at
+    };
+
+    Clock::duration tick;
+    Clock::time_point origin;
+    uint64_t cursor;  // Last tick processed
+    std::vector<std::vector<Timer>> slots;
+    std::vector<T> due;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,55 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Lock-free token bucket implemented as GCRA: the whole state is one
+// "theoretical arrival time", so a check is a clock read and one CAS.
+// A rate of 0 disables the limit.
+class TokenBucket {
+public:
+    TokenBucket() : interval_ns(0), tolerance_ns(0), tat(0) {}
+
+    // Not synchronized with tryConsume; configure before sharing the bucket
+    void configure(double rate_per_second, double burst) {
+        if (rate_per_second <= 0) {
+            interval_ns = 0;
+            return;
+        }
+        interval_ns = static_cast<int64_t>(1e9 / rate_per_second);
+        tolerance_ns = static_cast<int64_t>(interval_ns * std::max(burst - 1.0, 0.0));
+        tat.store(0, std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return interval_ns > 0; }
+
+    bool tryConsume() {
+        if (interval_ns == 0) {
+            return true;
+        }
+
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t current = tat.load(std::memory_order_relaxed);
+
+        while (true) {
+            int64_t start = std::max(current, now);
+            if (start - now > tolerance_ns) {
+                return false;  // Bucket empty
+            }
+            if (tat.compare_exchange_weak(current, start + interval_ns, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    int64_t interval_ns;   // Time one token takes to refill
+    int64_t tolerance_ns;  // How far ahead of schedule a burst may run
+    std::atomic<int64_t> tat;
+};
+
+#endif // TOKEN_BUCKET_H
@@ -1,68 +1,227 @@
 #include "trading_engine.h"
+#include "numa.h"
+#include "command_parser.h"
+#include "spread.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <set>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Recorded time of the journaled or replayed call running on this thread,
+// 0 outside one
+thread_local int64_t sequenced_time = 0;
+
+// Events of the journaled call running on this thread, published when it
+// has released its locks
+thread_local bool holding_events = false;
+thread_local std::vector<std::pair<const MarketEventHandlers*, BookEvents>> held_events;
+
+int64_t orderTimestamp() {
+    if (sequenced_time != 0) {
+        return sequenced_time;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void deliverEvents(const MarketEventHandlers& handlers, const BookEvents& events) {
+    for (const Fill& fill : events.fills) {
+        handlers.on_fill(fill);
+    }
+    for (const OrderCancel& cancel : events.cancels) {
+        handlers.on_cancel(cancel);
+    }
+    if (events.quote) {
+        handlers.on_quote(*events.quote);
+    }
+}
+
+void recordOrder(EngineCommand& command, const std::string& symbol, OrderSide side, double price, int quantity,
+                 int session_id, int owner_id, StpMode stp_mode) {
+    command.symbol = symbol;
+    command.side = side;
+    command.price = price;
+    command.quantity = quantity;
+    command.session_id = session_id;
+    command.owner_id = owner_id;
+    command.stp_mode = stp_mode;
+}
+
+}
+
+void publishBookEvents(const MarketEventHandlers& handlers, const BookEvents& events) {
+    if (holding_events) {
+        held_events.emplace_back(&handlers, events);
+    } else {
+        deliverEvents(handlers, events);
+    }
+}
 
 // Order Implementation
 
-Order::Order(const std::string& sym, OrderSide s, double p, int q, int id)
-    : symbol(sym), side(s), price(p), quantity(q), order_id(id) {
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    timestamp = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+Order::Order(const std::string& sym, OrderSide s, double p, int q, int id, int session, int owner, StpMode stp)
+    : symbol(sym), side(s), price(p), quantity(q), order_id(id), session_id(session), owner_id(owner),
+      stp_mode(stp), type(OrderType::LIMIT), stop_price(0.0), display_quantity(0), hidden_quantity(0) {
+    timestamp = orderTimestamp();
 }
 
-// OrderBook Implementation
+// BasicOrderBook Implementation
+
+namespace {
+
+// Copies a resting order's quantities from its slot back to the Order
+void syncOrder(const OrderSlot& slot) {
+    slot.order->quantity = slot.quantity;
+    slot.order->hidden_quantity = slot.hidden_quantity;
+}
+
+template <typename Stops>
+void eraseStop(Stops& stops, const std::shared_ptr<Order>& order) {
+    auto [first, last] = stops.equal_range(order->stop_price);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == order) {
+            stops.erase(it);
+            return;
+        }
+    }
+}
+
+// Shows the first slice of an iceberg and keeps the rest in reserve
+void splitIceberg(Order& order, int display_quantity) {
+    int total = order.totalQuantity();
+    order.display_quantity = display_quantity;
+    order.quantity = std::min(display_quantity, total);
+    order.hidden_quantity = total - order.quantity;
+}
+
+// Text appenders for the depth rendering, which runs on every book change
+// seen by a SHOW_ORDERS poll; same output as iostreams with std::fixed
+void appendInt(std::string& out, int64_t value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void appendPrice(std::string& out, double price) {
+    char buffer[328];  // Fits DBL_MAX in fixed notation
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), price, std::chars_format::fixed, 2);
+    out.append(buffer, result.ptr);
+}
+
+// "BUY 10 AAPL @ $150.00", plus the trigger for stops not yet triggered and
+// the slice size of icebergs. For the owner's eyes: includes hidden quantity.
+void appendOrder(std::string& out, const Order& order) {
+    out += order.side == OrderSide::BUY ? "BUY " : "SELL ";
+    appendInt(out, order.totalQuantity());
+    out += ' ';
+    out += order.symbol;
+    if (order.type == OrderType::MARKET || order.type == OrderType::STOP) {
+        out += " @ MARKET";
+    } else {
+        out += " @ $";
+        appendPrice(out, order.price);
+    }
+    if (order.type == OrderType::STOP || order.type == OrderType::STOP_LIMIT) {
+        out += " STOP $";
+        appendPrice(out, order.stop_price);
+    }
+    if (order.type == OrderType::FILL_OR_KILL) {
+        out += " FOK";
+    }
+    if (order.display_quantity > 0) {
+        out += " DISPLAY ";
+        appendInt(out, order.display_quantity);
+    }
+}
+
+std::string describeOrder(const Order& order) {
+    std::string out;
+    appendOrder(out, order);
+    return out;
+}
 
-void OrderBook::sortOrders() {
-    std::sort(buy_orders.begin(), buy_orders.end(),
-        [](const std::shared_ptr<Order>& a, const std::shared_ptr<Order>& b) {
-            if (a->price != b->price) {
-                return a->price > b->price;
-            }
-            return a->timestamp < b->timestamp;
-        });
-    
-    std::sort(sell_orders.begin(), sell_orders.end(),
-        [](const std::shared_ptr<Order>& a, const std::shared_ptr<Order>& b) {
-            if (a->price != b->price) {
-                return a->price < b->price;
-            }
-            return a->timestamp < b->timestamp;
-        });
 }
 
-std::string OrderBook::matchOrders() {
+template <typename Backend>
+std::string BasicOrderBook<Backend>::matchOrders(const Order* aggressor, double auction_price) {
     std::stringstream result;
     
-    sortOrders();
-    
-    while (!buy_orders.empty() && !sell_orders.empty()) {
-        auto& best_buy = buy_orders[0];
-        auto& best_sell = sell_orders[0];
+    while (!bids.empty() && !asks.empty()) {
+        double bid_price = bids.bestPrice();
+        double ask_price = asks.bestPrice();
+        
+        if (auction_price > 0 && (bid_price < auction_price || ask_price > auction_price)) {
+            break;
+        }
         
-        if (best_buy->price >= best_sell->price) {
+        if (bid_price >= ask_price) {
+            PriceLevel& best_bid = bids.bestLevel();
+            PriceLevel& best_ask = asks.bestLevel();
+            OrderSlot& best_buy = best_bid.front();
+            OrderSlot& best_sell = best_ask.front();
+            
+            // The incoming order is always one side of a cross; in an auction
+            // uncross there is none and the older order counts as resting
+            bool buy_is_newer = aggressor ? best_buy.order == aggressor
+                                          : !(best_buy.order->timestamp < best_sell.order->timestamp);
+            
+            if (best_buy.owner_id == best_sell.owner_id && best_buy.owner_id != 0) {
+                const Order& newer = buy_is_newer ? *best_buy.order : *best_sell.order;
+                if (newer.stp_mode != StpMode::NONE) {
+                    result << preventSelfTrade(best_buy, best_sell, buy_is_newer);
+                    continue;
+                }
+            }
+            
+            // Trades print at the resting order's price
             double execution_price;
-            if (best_buy->timestamp < best_sell->timestamp) {
-                execution_price = best_buy->price;
+            if (auction_price > 0) {
+                execution_price = auction_price;
             } else {
-                execution_price = best_sell->price;
+                execution_price = buy_is_newer ? ask_price : bid_price;
             }
+            last_trade_price = execution_price;
             
-            int trade_quantity = std::min(best_buy->quantity, best_sell->quantity);
+            int trade_quantity = std::min(best_buy.quantity, best_sell.quantity);
             
             result << "TRADE EXECUTED: " << trade_quantity << " " << symbol 
                    << " @ $" << std::fixed << std::setprecision(2) 
                    << execution_price << "\n";
             
-            best_buy->quantity -= trade_quantity;
-            best_sell->quantity -= trade_quantity;
+            metrics.trades.add();
+            metrics.volume.add(trade_quantity);
+            bid_quantity -= trade_quantity;
+            ask_quantity -= trade_quantity;
+            best_bid.total_quantity -= trade_quantity;
+            best_ask.total_quantity -= trade_quantity;
+            
+            best_buy.quantity -= trade_quantity;
+            best_sell.quantity -= trade_quantity;
+            
+            if (handlers && handlers->on_fill) {
+                pending_fills.push_back(Fill{symbol, best_buy.order_id, best_buy.session_id, best_buy.owner_id,
+                                             OrderSide::BUY, execution_price, trade_quantity,
+                                             best_buy.quantity + best_buy.hidden_quantity});
+                pending_fills.push_back(Fill{symbol, best_sell.order_id, best_sell.session_id, best_sell.owner_id,
+                                             OrderSide::SELL, execution_price, trade_quantity,
+                                             best_sell.quantity + best_sell.hidden_quantity});
+            }
             
-            if (best_buy->quantity == 0) {
-                buy_orders.erase(buy_orders.begin());
+            // Replenishing or removing one side leaves the other side's level alone
+            int buy_id = best_buy.order_id;
+            int sell_id = best_sell.order_id;
+            bool buy_done = best_buy.quantity == 0;
+            bool sell_done = best_sell.quantity == 0;
+            if (buy_done && !replenishOrder(buy_id)) {
+                removeOrder(buy_id);
             }
-            if (best_sell->quantity == 0) {
-                sell_orders.erase(sell_orders.begin());
+            if (sell_done && !replenishOrder(sell_id)) {
+                removeOrder(sell_id);
             }
         } else {
             break;
@@ -72,100 +231,1407 @@ std::string OrderBook::matchOrders() {
     return result.str();
 }
 
-std::string OrderBook::addOrder(std::shared_ptr<Order> order) {
-    std::lock_guard<std::mutex> lock(book_mutex);
+template <typename Backend>
+std::optional<double> BasicOrderBook<Backend>::equilibriumPrice() const {
+    if (bids.empty() || asks.empty() || bids.bestPrice() < asks.bestPrice()) {
+        return std::nullopt;
+    }
+    
+    // Candidate prices are the levels in [best ask, best bid], visited in
+    // ascending order. Demand at p is the bid quantity at or above p, supply
+    // the ask quantity at or below p.
+    double low = asks.bestPrice();
+    double high = bids.bestPrice();
+    
+    std::vector<std::pair<double, int64_t>> crossed_bids;  // Best (highest) first
+    std::vector<std::pair<double, int64_t>> crossed_asks;  // Best (lowest) first
+    int64_t demand = 0;
+    bids.forEach([&](double price, const PriceLevel& level) {
+        if (price < low) {
+            return false;
+        }
+        crossed_bids.emplace_back(price, level.total_quantity);
+        demand += level.total_quantity;
+        return true;
+    });
+    asks.forEach([&](double price, const PriceLevel& level) {
+        if (price > high) {
+            return false;
+        }
+        crossed_asks.emplace_back(price, level.total_quantity);
+        return true;
+    });
+    int64_t supply = 0;
+    
+    auto ask = crossed_asks.begin();
+    auto bid = crossed_bids.rbegin();
+    
+    double best_price = 0.0;
+    int64_t best_volume = -1;
+    int64_t best_imbalance = 0;
+    
+    while (true) {
+        bool have_ask = ask != crossed_asks.end();
+        bool have_bid = bid != crossed_bids.rend();
+        if (!have_ask && !have_bid) {
+            break;
+        }
+        double price = !have_ask ? bid->first : !have_bid ? ask->first : std::min(ask->first, bid->first);
+        
+        if (have_ask && ask->first == price) {
+            supply += ask->second;
+            ++ask;
+        }
+        
+        int64_t volume = std::min(demand, supply);
+        int64_t imbalance = std::abs(demand - supply);
+        bool better = volume > best_volume ||
+                      (volume == best_volume && imbalance < best_imbalance) ||
+                      (volume == best_volume && imbalance == best_imbalance && last_trade_price > 0 &&
+                       std::fabs(price - last_trade_price) < std::fabs(best_price - last_trade_price));
+        if (better) {
+            best_price = price;
+            best_volume = volume;
+            best_imbalance = imbalance;
+        }
+        
+        // Bids at this price don't buy at any higher one
+        if (have_bid && bid->first == price) {
+            demand -= bid->second;
+            ++bid;
+        }
+    }
+    
+    return best_price;
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::triggerStops() {
+    std::stringstream result;
     
+    while (!in_auction && last_trade_price > 0) {
+        std::shared_ptr<Order> order;
+        if (!buy_stops.empty() && buy_stops.begin()->first <= last_trade_price) {
+            order = buy_stops.begin()->second;
+            buy_stops.erase(buy_stops.begin());
+        } else if (!sell_stops.empty() && sell_stops.begin()->first >= last_trade_price) {
+            order = sell_stops.begin()->second;
+            sell_stops.erase(sell_stops.begin());
+        } else {
+            break;
+        }
+        stop_index.erase(order->order_id);
+        // insertOrder lists it again if it rests; a killed one must not stay
+        forgetSessionOrder(order->session_id, order->order_id);
+        
+        result << "STOP TRIGGERED: " << describeOrder(*order) << "\n";
+        
+        // The activated order queues behind everything already resting
+        order->timestamp = orderTimestamp();
+        if (order->type == OrderType::STOP) {
+            order->type = OrderType::MARKET;
+        } else {
+            order->type = OrderType::LIMIT;
+        }
+        result << insertOrder(order);
+    }
+    
+    return result.str();
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::preventSelfTrade(OrderSlot& buy, OrderSlot& sell, bool buy_is_newer) {
     std::stringstream msg;
+    int newer_id = buy_is_newer ? buy.order_id : sell.order_id;
+    int older_id = buy_is_newer ? sell.order_id : buy.order_id;
+    StpMode mode = (buy_is_newer ? buy : sell).order->stp_mode;
+    
+    auto cancel = [&](int order_id) {
+        auto order = removeOrder(order_id);
+        recordCancel(*order, order->totalQuantity());
+        msg << "SELF-TRADE PREVENTED: Order " << order_id << " cancelled\n";
+    };
+    
+    switch (mode) {
+        case StpMode::CANCEL_OLDEST:
+            cancel(older_id);
+            break;
+        case StpMode::CANCEL_BOTH:
+            cancel(newer_id);
+            cancel(older_id);
+            break;
+        case StpMode::DECREMENT: {
+            // Both orders are at the front of the best levels, as in a trade
+            int overlap = std::min(buy.quantity, sell.quantity);
+            msg << "SELF-TRADE PREVENTED: Orders " << older_id << " and " << newer_id
+                << " decremented by " << overlap << "\n";
+            
+            syncOrder(buy);
+            syncOrder(sell);
+            recordCancel(*buy.order, overlap);
+            recordCancel(*sell.order, overlap);
+            bid_quantity -= overlap;
+            ask_quantity -= overlap;
+            bids.bestLevel().total_quantity -= overlap;
+            asks.bestLevel().total_quantity -= overlap;
+            buy.quantity -= overlap;
+            sell.quantity -= overlap;
+            
+            bool buy_done = buy.quantity == 0;
+            bool sell_done = sell.quantity == 0;
+            if (buy_done && !replenishOrder(buy.order_id)) {
+                removeOrder(buy.order_id);
+            }
+            if (sell_done && !replenishOrder(sell.order_id)) {
+                removeOrder(sell.order_id);
+            }
+            break;
+        }
+        default:
+            cancel(newer_id);
+            break;
+    }
+    
+    return msg.str();
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::updateDepthMetrics() {
+    int64_t buy_levels = bids.size();
+    int64_t sell_levels = asks.size();
+    
+    metrics.bid_orders.set(bid_order_count);
+    metrics.ask_orders.set(ask_order_count);
+    metrics.bid_quantity.set(bid_quantity);
+    metrics.ask_quantity.set(ask_quantity);
+    metrics.bid_levels.set(buy_levels);
+    metrics.ask_levels.set(sell_levels);
+    metrics.max_levels.max(std::max(buy_levels, sell_levels));
+}
+
+template <typename Backend>
+Quote BasicOrderBook<Backend>::currentQuote() const {
+    Quote quote;
+    quote.symbol = symbol;
+    if (!bids.empty()) {
+        quote.bid_price = bids.bestPrice();
+        quote.bid_quantity = bids.bestLevel().total_quantity;
+    }
+    if (!asks.empty()) {
+        quote.ask_price = asks.bestPrice();
+        quote.ask_quantity = asks.bestLevel().total_quantity;
+    }
+    return quote;
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::collectEvents(BookEvents& events) {
+    events.fills.swap(pending_fills);
+    events.cancels.swap(pending_cancels);
+    pending_fills.clear();
+    pending_cancels.clear();
     
+    Quote current = currentQuote();
+    if (!(current == last_quote)) {
+        last_quote = current;
+        published_quote.publish(current);
+        if (handlers && handlers->on_quote) {
+            events.quote = current;
+        }
+    }
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::publishEvents(const BookEvents& events) const {
+    publishBookEvents(*handlers, events);
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::recordCancel(const Order& order, int quantity) {
+    recordCancel(order, quantity, order.totalQuantity() - quantity);
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::recordCancel(const Order& order, int quantity, int remaining) {
+    if (handlers && handlers->on_cancel) {
+        pending_cancels.push_back(OrderCancel{symbol, order.order_id, order.session_id, order.owner_id,
+                                              order.side, order.price, quantity, remaining});
+    }
+}
+
+template <typename Backend>
+const Order* BasicOrderBook<Backend>::findOrder(int order_id) const {
+    auto it = order_index.find(order_id);
+    if (it != order_index.end()) {
+        return it->second.order.get();
+    }
+    auto stop = stop_index.find(order_id);
+    return stop != stop_index.end() ? stop->second.get() : nullptr;
+}
+
+template <typename Backend>
+PriceLevel& BasicOrderBook<Backend>::levelOf(const OrderLocation& location) {
+    return onSide(location.side, [&](auto& levels) -> PriceLevel& { return *levels.find(location.price); });
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::reindexLevel(const PriceLevel& level) {
+    level.forEachOrder([this](uint64_t position, const OrderSlot& slot) {
+        order_index.find(slot.order_id)->second.position = position;
+    });
+}
+
+template <typename Backend>
+std::shared_ptr<Order> BasicOrderBook<Backend>::removeOrder(int order_id) {
+    std::shared_ptr<Order> order;
+    
+    auto it = order_index.find(order_id);
+    if (it != order_index.end()) {
+        OrderLocation location = it->second;
+        order = location.order;
+        order_index.erase(it);
+        
+        PriceLevel& level = levelOf(location);
+        const OrderSlot& slot = level.at(location.position);
+        syncOrder(slot);
+        level.total_quantity -= slot.quantity;
+        if (location.side == OrderSide::BUY) {
+            bid_quantity -= slot.quantity;
+            --bid_order_count;
+        } else {
+            ask_quantity -= slot.quantity;
+            --ask_order_count;
+        }
+        
+        if (level.remove(location.position)) {
+            reindexLevel(level);
+        }
+        if (level.empty()) {
+            onSide(location.side, [&](auto& levels) { levels.erase(location.price); });
+        }
+    } else {
+        auto stop = stop_index.find(order_id);
+        if (stop == stop_index.end()) {
+            return nullptr;
+        }
+        order = stop->second;
+        stop_index.erase(stop);
+        
+        if (order->side == OrderSide::BUY) {
+            eraseStop(buy_stops, order);
+        } else {
+            eraseStop(sell_stops, order);
+        }
+    }
+    
+    forgetSessionOrder(order->session_id, order_id);
+    return order;
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::forgetSessionOrder(int session_id, int order_id) {
+    auto session = session_orders.find(session_id);
+    if (session != session_orders.end()) {
+        session->second.erase(order_id);
+        if (session->second.empty()) {
+            session_orders.erase(session);
+        }
+    }
+}
+
+template <typename Backend>
+bool BasicOrderBook<Backend>::acceptsPrice(OrderSide side, double price) const {
+    return onSide(side, [price](const auto& levels) { return levels.accepts(price); });
+}
+
+template <typename Backend>
+bool BasicOrderBook<Backend>::sweepLimit(OrderSide side, double& limit) const {
+    bool found = false;
+    onSide(side == OrderSide::BUY ? OrderSide::SELL : OrderSide::BUY, [&](const auto& levels) {
+        limit = levels.worstPrice();
+        if (acceptsPrice(side, limit)) {
+            found = true;
+            return;
+        }
+        // Opposite levels past this side's span would stretch a tick ladder
+        // across the gap, so the sweep stops at the last one it can reach
+        levels.forEach([&](double price, const PriceLevel&) {
+            if (!acceptsPrice(side, price)) {
+                return false;
+            }
+            limit = price;
+            found = true;
+            return true;
+        });
+    });
+    return found;
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::rejectOrder(const Order& order, const std::string& reason) {
+    // Release whatever upstream (risk) has counted for the order
+    recordCancel(order, order.totalQuantity());
+    return reason;
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::insertOrder(std::shared_ptr<Order> order) {
+    std::stringstream msg;
+    
+    if (order->type != OrderType::MARKET && !acceptsPrice(order->side, order->price)) {
+        return rejectOrder(*order, "ERROR: Price is off the tick grid or too far from the book\n");
+    }
+    
+    // Market orders are priced to sweep the opposite side, as far as their
+    // own side can hold the price; whatever is left is cancelled below
+    if (order->type == OrderType::MARKET) {
+        bool can_trade = !in_auction && (order->side == OrderSide::BUY ? !asks.empty() : !bids.empty()) &&
+                         sweepLimit(order->side, order->price);
+        if (!can_trade) {
+            return rejectOrder(*order, "Order killed: " + describeOrder(*order) + " (Order ID: " +
+                                       std::to_string(order->order_id) + ") - no liquidity\n");
+        }
+    }
+    
+    if (order->type == OrderType::FILL_OR_KILL) {
+        int64_t available = 0;
+        if (!in_auction) {
+            available = order->side == OrderSide::BUY ? asks.depthAtOrBetter(order->price)
+                                                      : bids.depthAtOrBetter(order->price);
+        }
+        if (available < order->quantity) {
+            return rejectOrder(*order, "Order killed: " + describeOrder(*order) + " (Order ID: " +
+                                       std::to_string(order->order_id) + ") - insufficient liquidity\n");
+        }
+    }
+    
+    metrics.orders.add();
+    
+    OrderSlot slot{order.get(), order->quantity, order->hidden_quantity, order->order_id, order->owner_id,
+                   order->session_id};
     if (order->side == OrderSide::BUY) {
-        buy_orders.push_back(order);
-        msg << "Order added: BUY " << order->quantity << " " 
-            << order->symbol << " @ $" << std::fixed << std::setprecision(2) 
-            << order->price << " (Order ID: " << order->order_id << ")\n";
+        bid_quantity += order->quantity;
+        ++bid_order_count;
     } else {
-        sell_orders.push_back(order);
-        msg << "Order added: SELL " << order->quantity << " " 
-            << order->symbol << " @ $" << std::fixed << std::setprecision(2) 
-            << order->price << " (Order ID: " << order->order_id << ")\n";
+        ask_quantity += order->quantity;
+        ++ask_order_count;
     }
+    PriceLevel& level = onSide(order->side, [&](auto& levels) -> PriceLevel& {
+        return levels.getOrCreate(order->price);
+    });
+    level.total_quantity += order->quantity;
+    uint64_t position = level.push(slot);
+    msg << "Order added: " << describeOrder(*order) << " (Order ID: " << order->order_id << ")\n";
     
-    std::string match_result = matchOrders();
+    order_index[order->order_id] = OrderLocation{order->side, order->price, position, order};
+    session_orders[order->session_id].insert(order->order_id);
     
-    return msg.str() + match_result;
+    if (!in_auction) {
+        msg << matchOrders(order.get());
+    }
+    
+    // Market and FOK orders never rest; FOK only gets here if STP stopped a fill
+    if ((order->type == OrderType::MARKET || order->type == OrderType::FILL_OR_KILL) &&
+        order_index.count(order->order_id)) {
+        removeOrder(order->order_id);
+        msg << "Unfilled quantity cancelled: " << order->quantity
+            << " (Order ID: " << order->order_id << ")\n";
+        recordCancel(*order, order->quantity);
+    }
+    
+    return msg.str();
 }
 
-std::string OrderBook::displayOrders() const {
-    std::lock_guard<std::mutex> lock(book_mutex);
+template <typename Backend>
+bool BasicOrderBook<Backend>::replenishOrder(int order_id) {
+    OrderLocation& location = order_index.find(order_id)->second;
+    PriceLevel& level = levelOf(location);
+    OrderSlot slot = level.at(location.position);
+    if (slot.hidden_quantity == 0) {
+        return false;
+    }
     
-    std::stringstream output;
+    int slice = std::min(slot.order->display_quantity, slot.hidden_quantity);
+    slot.hidden_quantity -= slice;
+    slot.quantity = slice;
+    slot.order->timestamp = orderTimestamp();
     
-    output << "\n=== " << symbol << " Order Book ===\n";
+    // The new slice loses time priority: it moves to the back of its level.
+    // The level stays in the book even if the order was alone in it.
+    if (level.remove(location.position)) {
+        reindexLevel(level);
+    }
+    location.position = level.push(slot);
+    level.total_quantity += slice;
+    if (location.side == OrderSide::BUY) {
+        bid_quantity += slice;
+    } else {
+        ask_quantity += slice;
+    }
+    return true;
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::insertStop(std::shared_ptr<Order> order) {
+    if (order->type == OrderType::STOP_LIMIT && !acceptsPrice(order->side, order->price)) {
+        return rejectOrder(*order, "ERROR: Price is off the tick grid or too far from the book\n");
+    }
+    metrics.orders.add();
     
-    output << "\nBUY ORDERS:\n";
-    if (buy_orders.empty()) {
-        output << "  No buy orders\n";
+    if (order->side == OrderSide::BUY) {
+        buy_stops.emplace(order->stop_price, order);
     } else {
-        for (const auto& order : buy_orders) {
-            output << "  Order #" << order->order_id << ": "
-                   << order->quantity << " @ $" << std::fixed << std::setprecision(2)
-                   << order->price << "\n";
+        sell_stops.emplace(order->stop_price, order);
+    }
+    stop_index[order->order_id] = order;
+    session_orders[order->session_id].insert(order->order_id);
+    
+    return "Stop order added: " + describeOrder(*order) + " (Order ID: " + std::to_string(order->order_id) + ")\n";
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::replaceOrder(int order_id, double price, int quantity, int session_id,
+                                                 int owner_id, StpMode stp_mode) {
+    auto it = order_index.find(order_id);
+    if (it == order_index.end() || it->second.order->session_id != session_id) {
+        return "ERROR: Order " + std::to_string(order_id) + " not found\n";
+    }
+    if (!acceptsPrice(it->second.side, price)) {
+        return "ERROR: Price is off the tick grid or too far from the book\n";
+    }
+    
+    auto old_order = removeOrder(order_id);
+    
+    // The old terms are cancelled with the new quantity remaining, so the
+    // owner sees the change and risk keeps counting one open order
+    recordCancel(*old_order, old_order->totalQuantity(), quantity);
+    
+    // Re-queue behind everything already resting at the new price
+    auto order = std::make_shared<Order>(symbol, old_order->side, price, quantity, order_id,
+                                         session_id, owner_id, stp_mode);
+    if (old_order->display_quantity > 0) {
+        splitIceberg(*order, old_order->display_quantity);
+    }
+    std::string result = insertOrder(order);
+    const std::string added = "Order added: ";
+    if (result.compare(0, added.size(), added) == 0) {
+        result.replace(0, added.size(), "Order replaced: ");
+    }
+    return result;
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::addOrder(std::shared_ptr<Order> order) {
+    std::string result;
+    BookEvents events;
+    
+    {
+        TimedLockGuard lock(book_mutex, metrics.book_lock);
+        result = order->stop_price > 0 ? insertStop(order) : insertOrder(order);
+        result += triggerStops();
+        ++version;
+        updateDepthMetrics();
+        collectEvents(events);
+    }
+    
+    publishEvents(events);
+    return result;
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::applyBatch(const std::vector<BatchEntry>& entries,
+                                         const std::vector<size_t>& indices, int session_id, int owner_id,
+                                         StpMode stp_mode, std::vector<std::string>& results) {
+    BookEvents events;
+    
+    {
+        TimedLockGuard lock(book_mutex, metrics.book_lock);
+        
+        for (size_t i : indices) {
+            const BatchEntry& entry = entries[i];
+            
+            if (entry.type == BatchEntry::Type::ADD) {
+                results[i] = insertOrder(std::make_shared<Order>(symbol, entry.side, entry.price, entry.quantity,
+                                                                 entry.order_id, session_id, owner_id, stp_mode));
+            } else {
+                results[i] = replaceOrder(entry.order_id, entry.price, entry.quantity, session_id, owner_id,
+                                          stp_mode);
+            }
+            results[i] += triggerStops();
         }
+        
+        ++version;
+        updateDepthMetrics();
+        collectEvents(events);
     }
     
-    output << "\nSELL ORDERS:\n";
-    if (sell_orders.empty()) {
-        output << "  No sell orders\n";
-    } else {
-        for (const auto& order : sell_orders) {
-            output << "  Order #" << order->order_id << ": "
-                   << order->quantity << " @ $" << std::fixed << std::setprecision(2)
-                   << order->price << "\n";
+    publishEvents(events);
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::cancelOrder(int order_id, int session_id) {
+    std::shared_ptr<Order> order;
+    BookEvents events;
+    
+    {
+        TimedLockGuard lock(book_mutex, metrics.book_lock);
+        
+        const Order* found = findOrder(order_id);
+        if (found == nullptr || found->session_id != session_id) {
+            return "ERROR: Order " + std::to_string(order_id) + " not found\n";
+        }
+        
+        order = removeOrder(order_id);
+        recordCancel(*order, order->totalQuantity());
+        ++version;
+        updateDepthMetrics();
+        collectEvents(events);
+    }
+    
+    publishEvents(events);
+    
+    return "Order cancelled: " + describeOrder(*order) + " (Order ID: " + std::to_string(order_id) + ")\n";
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::countOpenOrders(std::unordered_map<int, int>& by_owner) const {
+    TimedLockGuard lock(book_mutex, metrics.book_lock);
+    for (const auto& [order_id, location] : order_index) {
+        ++by_owner[location.order->owner_id];
+    }
+    for (const auto& [order_id, order] : stop_index) {
+        ++by_owner[order->owner_id];
+    }
+}
+
+template <typename Backend>
+int BasicOrderBook<Backend>::cancelSessionOrders(int session_id, std::optional<OrderSide> side) {
+    std::vector<int> to_cancel;
+    BookEvents events;
+    
+    {
+        TimedLockGuard lock(book_mutex, metrics.book_lock);
+        
+        auto session = session_orders.find(session_id);
+        if (session == session_orders.end()) {
+            return 0;
+        }
+        
+        // removeOrder edits the session's set, so collect the IDs first
+        for (int order_id : session->second) {
+            if (!side || findOrder(order_id)->side == *side) {
+                to_cancel.push_back(order_id);
+            }
+        }
+        
+        for (int order_id : to_cancel) {
+            auto order = removeOrder(order_id);
+            recordCancel(*order, order->totalQuantity());
+        }
+        
+        ++version;
+        updateDepthMetrics();
+        collectEvents(events);
+    }
+    
+    publishEvents(events);
+    return static_cast<int>(to_cancel.size());
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::startAuction() {
+    TimedLockGuard lock(book_mutex, metrics.book_lock);
+    
+    if (in_auction) {
+        return "ERROR: " + symbol + " is already in auction\n";
+    }
+    in_auction = true;
+    ++version;
+    return "OK: Auction started for " + symbol + "\n";
+}
+
+template <typename Backend>
+std::string BasicOrderBook<Backend>::uncrossAuction() {
+    std::stringstream result;
+    BookEvents events;
+    
+    {
+        TimedLockGuard lock(book_mutex, metrics.book_lock);
+        
+        if (!in_auction) {
+            return "ERROR: " + symbol + " is not in auction\n";
         }
+        in_auction = false;
+        
+        std::optional<double> price = equilibriumPrice();
+        if (price) {
+            result << "AUCTION UNCROSS: " << symbol << " @ $" << std::fixed << std::setprecision(2)
+                   << *price << "\n";
+            result << matchOrders(nullptr, *price);
+            result << triggerStops();
+        } else {
+            result << "AUCTION UNCROSS: " << symbol << " no crossing orders\n";
+        }
+        
+        ++version;
+        updateDepthMetrics();
+        collectEvents(events);
+    }
+    
+    publishEvents(events);
+    return result.str();
+}
+
+template <typename Backend>
+std::shared_ptr<const std::string> BasicOrderBook<Backend>::displayOrders() const {
+    TimedLockGuard lock(book_mutex, metrics.book_lock);
+    
+    if (snapshot && snapshot_version == version) {
+        return snapshot;
+    }
+    
+    // The last rendering is a good guess at the size of this one
+    auto output = std::make_shared<std::string>();
+    output->reserve(snapshot ? snapshot->size() + 256 : 256);
+    std::string& out = *output;
+    
+    auto displayLevels = [&out](const auto& levels) {
+        levels.forEach([&out](double price, const PriceLevel& level) {
+            level.forEachOrder([&](uint64_t, const OrderSlot& slot) {
+                out += "  Order #";
+                appendInt(out, slot.order_id);
+                out += ": ";
+                appendInt(out, slot.quantity);
+                out += " @ $";
+                appendPrice(out, price);
+                out += '\n';
+            });
+            return true;
+        });
+    };
+    
+    out += "\n=== ";
+    out += symbol;
+    out += in_auction ? " Order Book (AUCTION) ===\n" : " Order Book ===\n";
+    
+    out += "\nBUY ORDERS:\n";
+    if (bids.empty()) {
+        out += "  No buy orders\n";
+    } else {
+        displayLevels(bids);
+    }
+    
+    out += "\nSELL ORDERS:\n";
+    if (asks.empty()) {
+        out += "  No sell orders\n";
+    } else {
+        displayLevels(asks);
     }
     
-    output << "\n";
+    if (!stop_index.empty()) {
+        out += "\nSTOP ORDERS:\n";
+        auto displayStops = [&out](const auto& stops) {
+            for (const auto& entry : stops) {
+                out += "  Order #";
+                appendInt(out, entry.second->order_id);
+                out += ": ";
+                appendOrder(out, *entry.second);
+                out += '\n';
+            }
+        };
+        displayStops(buy_stops);
+        displayStops(sell_stops);
+    }
     
-    return output.str();
+    out += "\n";
+    
+    snapshot = std::move(output);
+    snapshot_version = version;
+    return snapshot;
+}
+
+template <typename Backend>
+Quote BasicOrderBook<Backend>::getQuote() const {
+    TimedLockGuard lock(book_mutex, metrics.book_lock);
+    return currentQuote();
+}
+
+template <typename Backend>
+std::optional<BestOrder> BasicOrderBook<Backend>::bestOrder(OrderSide side) const {
+    return onSide(side, [this](const auto& levels) -> std::optional<BestOrder> {
+        if (in_auction || levels.empty()) {
+            return std::nullopt;
+        }
+        return BestOrder{levels.bestPrice(), levels.bestLevel().front().quantity};
+    });
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::fillBest(OrderSide side, double price, int quantity) {
+    onSide(side, [&](auto& levels) {
+        PriceLevel& level = levels.bestLevel();
+        OrderSlot& slot = level.front();
+        
+        last_trade_price = price;
+        metrics.trades.add();
+        metrics.volume.add(quantity);
+        level.total_quantity -= quantity;
+        (side == OrderSide::BUY ? bid_quantity : ask_quantity) -= quantity;
+        slot.quantity -= quantity;
+        
+        if (handlers && handlers->on_fill) {
+            pending_fills.push_back(Fill{symbol, slot.order_id, slot.session_id, slot.owner_id, side, price,
+                                         quantity, slot.quantity + slot.hidden_quantity});
+        }
+        
+        int order_id = slot.order_id;
+        if (slot.quantity == 0 && !replenishOrder(order_id)) {
+            removeOrder(order_id);
+        }
+    });
+}
+
+template <typename Backend>
+void BasicOrderBook<Backend>::finishImplied(BookEvents& events) {
+    triggerStops();
+    ++version;
+    updateDepthMetrics();
+    collectEvents(events);
+}
+
+// The backends a book can be built on
+template class BasicOrderBook<TreeBook>;
+template class BasicOrderBook<TickTreeBook>;
+template class BasicOrderBook<LadderBook>;
+
+std::unique_ptr<OrderBook> makeOrderBook(const std::string& symbol, const MarketEventHandlers* handlers,
+                                         BookType type, double tick_size) {
+    switch (type) {
+        case BookType::TICK_TREE:
+            return std::make_unique<BasicOrderBook<TickTreeBook>>(symbol, handlers, tick_size);
+        case BookType::LADDER:
+            return std::make_unique<BasicOrderBook<LadderBook>>(symbol, handlers, tick_size);
+        default:
+            return std::make_unique<BasicOrderBook<TreeBook>>(symbol, handlers, 0.0);
+    }
 }
 
 // TradingEngine Implementation
 
+TradingEngine::TradingEngine()
+    : next_order_id(1), listed_books(nullptr), book_node(-1), has_spreads(false), spread_generation(0),
+      last_sequence(0) {
+}
+
+TradingEngine::~TradingEngine() = default;
+
+TradingEngine::Sequenced::Sequenced(int first_id, int64_t time, std::vector<std::unique_lock<std::mutex>> held)
+    : first_order_id(first_id), locks(std::move(held)), timed(true), holding_events(!locks.empty()) {
+    sequenced_time = time;
+    if (holding_events) {
+        ::holding_events = true;
+    }
+}
+
+TradingEngine::Sequenced::~Sequenced() {
+    locks.clear();
+    if (timed) {
+        sequenced_time = 0;
+    }
+    if (holding_events) {
+        ::holding_events = false;
+        std::vector<std::pair<const MarketEventHandlers*, BookEvents>> events;
+        events.swap(held_events);
+        for (const auto& [handlers, book_events] : events) {
+            deliverEvents(*handlers, book_events);
+        }
+        events.clear();
+        held_events.swap(events);  // Keeps the capacity for the next call
+    }
+}
+
+std::vector<std::unique_lock<std::mutex>> TradingEngine::lockSymbols(const EngineCommand& command) {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    if (command.type == EngineCommand::Type::ACCOUNT) {
+        return locks;
+    }
+    
+    // A mass cancel on every book takes them all and keeps ordering_mutex,
+    // so no call can start on a book it has not locked
+    if (command.type == EngineCommand::Type::CANCEL_ALL && command.symbol.empty()) {
+        locks.emplace_back(ordering_mutex);
+        for (auto& [symbol, mutex] : symbol_locks) {
+            locks.emplace_back(mutex);
+        }
+        return locks;
+    }
+    
+    std::vector<std::string> symbols;
+    for (const std::string* symbol : {&command.symbol, &command.buy_leg, &command.sell_leg}) {
+        if (!symbol->empty()) {
+            symbols.push_back(*symbol);
+        }
+    }
+    for (const BatchEntry& entry : command.batch) {
+        symbols.push_back(entry.symbol);
+    }
+    
+    while (true) {
+        std::vector<std::mutex*> mutexes;
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> ordering(ordering_mutex);
+            generation = spread_generation.load(std::memory_order_acquire);
+            
+            // Every symbol an implied trade could reach from these
+            std::set<std::string> reached(symbols.begin(), symbols.end());
+            if (has_spreads.load(std::memory_order_acquire)) {
+                TimedLockGuard lock(engine_mutex, engine_lock_stats);
+                std::vector<std::string> pending(reached.begin(), reached.end());
+                while (!pending.empty()) {
+                    auto it = spreads_by_symbol.find(pending.back());
+                    pending.pop_back();
+                    if (it == spreads_by_symbol.end()) {
+                        continue;
+                    }
+                    for (const Spread* spread : it->second) {
+                        for (const std::string* name : {&spread->symbol(), &spread->buyLeg(), &spread->sellLeg()}) {
+                            if (reached.insert(*name).second) {
+                                pending.push_back(*name);
+                            }
+                        }
+                    }
+                }
+            }
+            for (const std::string& symbol : reached) {
+                mutexes.push_back(&symbol_locks[symbol]);
+            }
+        }
+        
+        for (std::mutex* mutex : mutexes) {
+            locks.emplace_back(*mutex);
+        }
+        // A spread defined meanwhile may link in books these do not cover
+        if (spread_generation.load(std::memory_order_acquire) == generation) {
+            return locks;
+        }
+        locks.clear();
+    }
+}
+
+template <typename Describe>
+TradingEngine::Sequenced TradingEngine::sequence(EngineCommand::Type type, int order_ids, Describe&& describe) {
+    if (!journal) {
+        return Sequenced(next_order_id.fetch_add(order_ids));
+    }
+    
+    thread_local EngineCommand recorded;
+    recorded = EngineCommand();
+    recorded.type = type;
+    describe(recorded);
+    std::vector<std::unique_lock<std::mutex>> locks = lockSymbols(recorded);
+    {
+        std::lock_guard<std::mutex> lock(sequence_mutex);
+        recorded.sequence = ++last_sequence;
+        recorded.time = orderTimestamp();  // Kept from the original when relaying a replayed call
+        recorded.next_order_id = next_order_id.fetch_add(order_ids);
+        journal(recorded);
+    }
+    return Sequenced(recorded.next_order_id, recorded.time, std::move(locks));
+}
+
+bool TradingEngine::replay(const EngineCommand& command, std::string* response) {
+    if (command.next_order_id != next_order_id.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    
+    Sequenced timing(0, command.time, {});
+    const EngineCommand& c = command;
+    std::string result;
+    switch (c.type) {
+        case EngineCommand::Type::ADD_ORDER:
+            result = addOrder(c.symbol, c.side, c.price, c.quantity, c.session_id, c.owner_id, c.stp_mode);
+            break;
+        case EngineCommand::Type::FILL_OR_KILL:
+            result = addFillOrKillOrder(c.symbol, c.side, c.price, c.quantity, c.session_id, c.owner_id,
+                                        c.stp_mode);
+            break;
+        case EngineCommand::Type::ICEBERG:
+            result = addIcebergOrder(c.symbol, c.side, c.price, c.quantity, c.display_quantity, c.session_id,
+                                     c.owner_id, c.stp_mode);
+            break;
+        case EngineCommand::Type::STOP:
+            result = addStopOrder(c.symbol, c.side, c.stop_price, c.price, c.quantity, c.session_id, c.owner_id,
+                                  c.stp_mode);
+            break;
+        case EngineCommand::Type::BATCH:
+            result = addBatch(c.batch, c.session_id, c.owner_id, c.stp_mode);
+            break;
+        case EngineCommand::Type::CANCEL:
+            result = cancelOrder(c.symbol, c.order_id, c.session_id);
+            break;
+        case EngineCommand::Type::CANCEL_ALL:
+            result = std::to_string(cancelAll(c.session_id, c.symbol,
+                                              c.any_side ? std::nullopt : std::optional<OrderSide>(c.side))) +
+                     " orders cancelled\n";
+            break;
+        case EngineCommand::Type::BOOK_TYPE:
+            result = setBookType(c.symbol, c.book_type, c.tick_size) ? "OK\n" : "ERROR: Book already exists\n";
+            break;
+        case EngineCommand::Type::SPREAD:
+            result = defineSpread(c.symbol, c.buy_leg, c.sell_leg);
+            break;
+        case EngineCommand::Type::AUCTION_START:
+            result = startAuction(c.symbol);
+            break;
+        case EngineCommand::Type::AUCTION_UNCROSS:
+            result = uncrossAuction(c.symbol);
+            break;
+        case EngineCommand::Type::ACCOUNT:
+            recordAccount(c.owner_id, c.symbol);
+            result = "OK\n";
+            break;
+    }
+    if (response) {
+        *response = std::move(result);
+    }
+    return true;
+}
+
 OrderBook* TradingEngine::findOrderBook(const std::string& symbol) {
     auto it = order_books.find(symbol);
     if (it != order_books.end()) {
-        return &it->second;
+        return it->second.get();
     }
     return nullptr;
 }
 
-std::string TradingEngine::addOrder(const std::string& symbol, OrderSide side, double price, int quantity) {
-    auto order = std::make_shared<Order>(symbol, side, price, quantity, next_order_id++);
+OrderBook* TradingEngine::getOrCreateOrderBook(const std::string& symbol) {
+    auto existing = order_books.find(symbol);
+    if (existing != order_books.end()) {
+        return existing->second.get();
+    }
     
+    ScopedNumaPreference placement(book_node);
+    auto [it, inserted] = order_books.try_emplace(symbol);
+    if (inserted) {
+        auto type = book_types.find(symbol);
+        it->second = type == book_types.end()
+                         ? makeOrderBook(symbol, &handlers, BookType::TREE, 0.0)
+                         : makeOrderBook(symbol, &handlers, type->second.first, type->second.second);
+        
+        // Complete the node before readers can reach it
+        auto node = std::make_unique<ListedBook>();
+        node->symbol = symbol;
+        node->book = it->second.get();
+        node->next = listed_books.load(std::memory_order_relaxed);
+        listed_books.store(node.get(), std::memory_order_release);
+        listed_book_nodes.push_back(std::move(node));
+    }
+    return it->second.get();
+}
+
+void TradingEngine::setBookNode(int node) {
+    TimedLockGuard lock(engine_mutex, engine_lock_stats);
+    book_node = node;
+}
+
+bool TradingEngine::setBookType(const std::string& symbol, BookType type, double tick_size) {
+    auto sequenced = sequence(EngineCommand::Type::BOOK_TYPE, 0, [&](EngineCommand& command) {
+        command.symbol = symbol;
+        command.book_type = type;
+        command.tick_size = tick_size;
+    });
+    TimedLockGuard lock(engine_mutex, engine_lock_stats);
+    
+    if ((type != BookType::TREE && tick_size <= 0) || findOrderBook(symbol) != nullptr) {
+        return false;
+    }
+    book_types[symbol] = {type, tick_size};
+    return true;
+}
+
+std::string TradingEngine::submitOrder(std::shared_ptr<Order> order) {
     OrderBook* book = nullptr;
     
     {
-        std::lock_guard<std::mutex> lock(engine_mutex);
-        
-        // try_emplace constructs in-place if symbol doesn't exist
-        auto [it, inserted] = order_books.try_emplace(symbol, symbol);
-        book = &it->second;
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        book = getOrCreateOrderBook(order->symbol);
     }
     
-    return book->addOrder(order);
+    std::string result = book->addOrder(order);
+    updateSpreads(order->symbol);
+    return result;
 }
 
-std::string TradingEngine::showOrders(const std::string& symbol) {
-    std::lock_guard<std::mutex> lock(engine_mutex);
+std::string TradingEngine::addOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                                   int session_id, int owner_id, StpMode stp_mode, int* assigned_id) {
+    auto sequenced = sequence(EngineCommand::Type::ADD_ORDER, 1, [&](EngineCommand& command) {
+        recordOrder(command, symbol, side, price, quantity, session_id, owner_id, stp_mode);
+    });
+    auto order = std::make_shared<Order>(symbol, side, price, quantity, sequenced.first_order_id,
+                                         session_id, owner_id, stp_mode);
+    if (assigned_id) {
+        *assigned_id = order->order_id;
+    }
+    return submitOrder(order);
+}
+
+std::string TradingEngine::addFillOrKillOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                                             int session_id, int owner_id, StpMode stp_mode, int* assigned_id) {
+    auto sequenced = sequence(EngineCommand::Type::FILL_OR_KILL, 1, [&](EngineCommand& command) {
+        recordOrder(command, symbol, side, price, quantity, session_id, owner_id, stp_mode);
+    });
+    auto order = std::make_shared<Order>(symbol, side, price, quantity, sequenced.first_order_id,
+                                         session_id, owner_id, stp_mode);
+    order->type = OrderType::FILL_OR_KILL;
+    if (assigned_id) {
+        *assigned_id = order->order_id;
+    }
+    return submitOrder(order);
+}
+
+std::string TradingEngine::addIcebergOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                                          int display_quantity, int session_id, int owner_id, StpMode stp_mode) {
+    auto sequenced = sequence(EngineCommand::Type::ICEBERG, 1, [&](EngineCommand& command) {
+        recordOrder(command, symbol, side, price, quantity, session_id, owner_id, stp_mode);
+        command.display_quantity = display_quantity;
+    });
+    auto order = std::make_shared<Order>(symbol, side, price, quantity, sequenced.first_order_id,
+                                         session_id, owner_id, stp_mode);
+    splitIceberg(*order, display_quantity);
+    return submitOrder(order);
+}
+
+std::string TradingEngine::addStopOrder(const std::string& symbol, OrderSide side, double stop_price,
+                                       double limit_price, int quantity, int session_id, int owner_id,
+                                       StpMode stp_mode) {
+    auto sequenced = sequence(EngineCommand::Type::STOP, 1, [&](EngineCommand& command) {
+        recordOrder(command, symbol, side, limit_price, quantity, session_id, owner_id, stp_mode);
+        command.stop_price = stop_price;
+    });
+    auto order = std::make_shared<Order>(symbol, side, limit_price, quantity, sequenced.first_order_id,
+                                         session_id, owner_id, stp_mode);
+    order->type = limit_price > 0 ? OrderType::STOP_LIMIT : OrderType::STOP;
+    order->stop_price = stop_price;
+    return submitOrder(order);
+}
+
+std::string TradingEngine::addBatch(std::vector<BatchEntry> entries, int session_id, int owner_id,
+                                    StpMode stp_mode) {
+    int adds = static_cast<int>(std::count_if(entries.begin(), entries.end(), [](const BatchEntry& entry) {
+        return entry.type == BatchEntry::Type::ADD;
+    }));
+    auto sequenced = sequence(EngineCommand::Type::BATCH, adds, [&](EngineCommand& command) {
+        command.batch = entries;
+        command.session_id = session_id;
+        command.owner_id = owner_id;
+        command.stp_mode = stp_mode;
+    });
+    
+    // Group entries by symbol, keeping their relative order within each book
+    std::map<std::string, std::vector<size_t>> by_symbol;
+    int next_id = sequenced.first_order_id;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].type == BatchEntry::Type::ADD) {
+            entries[i].order_id = next_id++;
+        }
+        by_symbol[entries[i].symbol].push_back(i);
+    }
+    
+    std::vector<std::pair<OrderBook*, const std::vector<size_t>*>> books;
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        for (const auto& [symbol, indices] : by_symbol) {
+            books.emplace_back(getOrCreateOrderBook(symbol), &indices);
+        }
+    }
+    
+    std::vector<std::string> results(entries.size());
+    for (auto& [book, indices] : books) {
+        book->applyBatch(entries, *indices, session_id, owner_id, stp_mode, results);
+    }
+    for (const auto& [symbol, indices] : by_symbol) {
+        updateSpreads(symbol);
+    }
+    
+    int rejected = 0;
+    std::stringstream response;
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].compare(0, 6, "ERROR:") == 0) {
+            ++rejected;
+        }
+        response << "[" << (i + 1) << "] " << results[i];
+    }
+    
+    return "BATCH OK: " + std::to_string(entries.size() - rejected) + " accepted, " +
+           std::to_string(rejected) + " rejected\n" + response.str();
+}
+
+std::string TradingEngine::cancelOrder(const std::string& symbol, int order_id, int session_id) {
+    auto sequenced = sequence(EngineCommand::Type::CANCEL, 0, [&](EngineCommand& command) {
+        command.symbol = symbol;
+        command.order_id = order_id;
+        command.session_id = session_id;
+    });
+    OrderBook* book = nullptr;
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        book = findOrderBook(symbol);
+    }
+    
+    if (book == nullptr) {
+        return "ERROR: Order " + std::to_string(order_id) + " not found\n";
+    }
+    std::string result = book->cancelOrder(order_id, session_id);
+    updateSpreads(symbol);
+    return result;
+}
+
+std::string TradingEngine::startAuction(const std::string& symbol) {
+    auto sequenced = sequence(EngineCommand::Type::AUCTION_START, 0,
+                              [&](EngineCommand& command) { command.symbol = symbol; });
+    OrderBook* book = nullptr;
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        // Spread prices may be zero or negative, which the uncross cannot price
+        if (spreads.count(symbol) != 0) {
+            return "ERROR: " + symbol + " is a spread and has no auction\n";
+        }
+        book = getOrCreateOrderBook(symbol);
+    }
+    
+    return book->startAuction();
+}
+
+std::string TradingEngine::uncrossAuction(const std::string& symbol) {
+    auto sequenced = sequence(EngineCommand::Type::AUCTION_UNCROSS, 0,
+                              [&](EngineCommand& command) { command.symbol = symbol; });
+    OrderBook* book = nullptr;
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        book = findOrderBook(symbol);
+    }
     
-    OrderBook* book = findOrderBook(symbol);
+    if (book == nullptr) {
+        return "ERROR: " + symbol + " is not in auction\n";
+    }
+    std::string result = book->uncrossAuction();
+    updateSpreads(symbol);
+    return result;
+}
+
+int TradingEngine::cancelAll(int session_id, const std::string& symbol, std::optional<OrderSide> side) {
+    auto sequenced = sequence(EngineCommand::Type::CANCEL_ALL, 0, [&](EngineCommand& command) {
+        command.session_id = session_id;
+        command.symbol = symbol;
+        command.any_side = !side;
+        command.side = side.value_or(OrderSide::BUY);
+    });
+    std::vector<std::pair<const std::string*, OrderBook*>> books;  // order_books keys are stable
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        if (symbol.empty()) {
+            for (auto& [sym, book] : order_books) {
+                books.emplace_back(&sym, book.get());
+            }
+        } else if (OrderBook* book = findOrderBook(symbol)) {
+            books.emplace_back(&symbol, book);
+        }
+    }
     
-    if (book != nullptr) {
-        return book->displayOrders();
+    int cancelled = 0;
+    for (const auto& [book_symbol, book] : books) {
+        int count = book->cancelSessionOrders(session_id, side);
+        if (count > 0) {
+            updateSpreads(*book_symbol);
+        }
+        cancelled += count;
+    }
+    return cancelled;
+}
+
+void TradingEngine::recordAccount(int account_id, const std::string& name) {
+    auto sequenced = sequence(EngineCommand::Type::ACCOUNT, 0, [&](EngineCommand& command) {
+        command.symbol = name;
+        command.owner_id = account_id;
+    });
+}
+
+std::unordered_map<int, int> TradingEngine::openOrdersByOwner() {
+    std::vector<const OrderBook*> books;
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        for (const auto& [symbol, book] : order_books) {
+            books.push_back(book.get());
+        }
+    }
+    
+    std::unordered_map<int, int> by_owner;
+    for (const OrderBook* book : books) {
+        book->countOpenOrders(by_owner);
+    }
+    return by_owner;
+}
+
+std::string TradingEngine::defineSpread(const std::string& symbol, const std::string& buy_leg,
+                                        const std::string& sell_leg) {
+    auto sequenced = sequence(EngineCommand::Type::SPREAD, 0, [&](EngineCommand& command) {
+        command.symbol = symbol;
+        command.buy_leg = buy_leg;
+        command.sell_leg = sell_leg;
+    });
+    TimedLockGuard lock(engine_mutex, engine_lock_stats);
+    
+    if (buy_leg == sell_leg || symbol == buy_leg || symbol == sell_leg) {
+        return "ERROR: A spread needs two different legs\n";
+    }
+    if (findOrderBook(symbol) != nullptr) {
+        return "ERROR: " + symbol + " already has a book\n";
+    }
+    if (spreads.count(buy_leg) != 0 || spreads.count(sell_leg) != 0) {
+        return "ERROR: Spread legs must be outrights\n";
+    }
+    
+    // Spread prices may be zero or negative, which only the TREE backend takes
+    book_types.erase(symbol);
+    OrderBook* book = getOrCreateOrderBook(symbol);
+    auto spread = std::make_unique<Spread>(symbol, book, buy_leg, getOrCreateOrderBook(buy_leg), sell_leg,
+                                           getOrCreateOrderBook(sell_leg), &handlers);
+    for (const std::string* name : {&symbol, &buy_leg, &sell_leg}) {
+        spreads_by_symbol[*name].push_back(spread.get());
+    }
+    spreads.emplace(symbol, std::move(spread));
+    has_spreads.store(true, std::memory_order_release);
+    spread_generation.fetch_add(1, std::memory_order_release);
+    return "OK: " + symbol + " is the spread " + buy_leg + " - " + sell_leg + "\n";
+}
+
+bool TradingEngine::isSpread(const std::string& symbol) {
+    if (!has_spreads.load(std::memory_order_acquire)) {
+        return false;
+    }
+    TimedLockGuard lock(engine_mutex, engine_lock_stats);
+    return spreads.count(symbol) != 0;
+}
+
+void TradingEngine::updateSpreads(const std::string& symbol) {
+    if (!has_spreads.load(std::memory_order_acquire)) {
+        return;
+    }
+    
+    // Each entry is a spread and the symbol whose change it reacts to
+    std::vector<std::pair<Spread*, std::string>> pending;
+    auto addSpreadsOn = [&](const std::string& changed, const Spread* except) {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        auto it = spreads_by_symbol.find(changed);
+        if (it != spreads_by_symbol.end()) {
+            for (Spread* spread : it->second) {
+                if (spread != except) {
+                    pending.emplace_back(spread, changed);
+                }
+            }
+        }
+    };
+    
+    // Implied trades only use up resting quantity, so this ends
+    addSpreadsOn(symbol, nullptr);
+    while (!pending.empty()) {
+        auto [spread, changed] = std::move(pending.back());
+        pending.pop_back();
+        if (spread->update(changed)) {
+            addSpreadsOn(spread->buyLeg(), spread);
+            addSpreadsOn(spread->sellLeg(), spread);
+        }
+    }
+}
+
+std::string TradingEngine::showOrders(const std::string& symbol) {
+    auto snapshot = orderSnapshot(symbol);
+    
+    if (snapshot) {
+        return *snapshot;
     } else {
         return "No orders found for symbol: " + symbol + "\n";
     }
 }
 
+std::shared_ptr<const std::string> TradingEngine::orderSnapshot(const std::string& symbol) {
+    OrderBook* book = nullptr;
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        book = findOrderBook(symbol);
+    }
+    
+    if (book == nullptr) {
+        return nullptr;
+    }
+    return book->displayOrders();
+}
+
+std::optional<Quote> TradingEngine::getQuote(const std::string& symbol) {
+    OrderBook* book = nullptr;
+    
+    {
+        TimedLockGuard lock(engine_mutex, engine_lock_stats);
+        book = findOrderBook(symbol);
+    }
+    
+    if (book == nullptr) {
+        return std::nullopt;
+    }
+    return book->getQuote();
+}
+
+std::vector<Quote> TradingEngine::getQuotes(const std::vector<std::string>& symbols) const {
+    std::vector<Quote> quotes;
+    const ListedBook* head = listed_books.load(std::memory_order_acquire);
+    
+    if (symbols.empty()) {
+        for (const ListedBook* node = head; node != nullptr; node = node->next) {
+            quotes.emplace_back();
+            quotes.back().symbol = node->symbol;
+            node->book->readQuote(quotes.back());
+        }
+        std::sort(quotes.begin(), quotes.end(),
+                  [](const Quote& a, const Quote& b) { return a.symbol < b.symbol; });
+        return quotes;
+    }
+    
+    // Requested names are sorted once, so the list is walked once however
+    // many are asked for; unlisted ones keep an empty quote
+    std::vector<size_t> by_name(symbols.size());
+    quotes.resize(symbols.size());
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        by_name[i] = i;
+        quotes[i].symbol = symbols[i];
+    }
+    std::sort(by_name.begin(), by_name.end(),
+              [&symbols](size_t a, size_t b) { return symbols[a] < symbols[b]; });
+    
+    for (const ListedBook* node = head; node != nullptr; node = node->next) {
+        auto first = std::lower_bound(by_name.begin(), by_name.end(), node->symbol,
+                                      [&symbols](size_t i, const std::string& name) { return symbols[i] < name; });
+        for (auto it = first; it != by_name.end() && symbols[*it] == node->symbol; ++it) {
+            node->book->readQuote(quotes[*it]);
+        }
+    }
+    return quotes;
+}
+
+void TradingEngine::collectMetrics(std::vector<std::pair<std::string, const SymbolMetrics*>>& out) {
+    TimedLockGuard lock(engine_mutex, engine_lock_stats);
+    
+    for (const auto& [symbol, book] : order_books) {
+        out.emplace_back(symbol, &book->getMetrics());
+    }
+}
+
 void TradingEngine::start() {
     std::cout << "Trading Engine Started..." << std::endl;
     std::cout << "\nCommands:" << std::endl;
@@ -181,20 +1647,20 @@ void TradingEngine::start() {
         
         if (line.empty()) continue;
         
-        std::istringstream iss(line);
-        std::string command;
-        iss >> command;
+        CommandParser parser(line);
+        std::string_view command = parser.next();
         
         if (command == "exit" || command == "quit") {
             std::cout << "Trading Engine Stopped." << std::endl;
             break;
         }
         else if (command == "add_order") {
-            std::string side_str, symbol;
+            std::string_view side_str;
+            std::string symbol;
             double price;
             int quantity;
             
-            if (!(iss >> side_str >> symbol >> price >> quantity)) {
+            if (!parser.read(side_str, symbol, price, quantity)) {
                 std::cout << "Invalid command format. Use: add_order <BUY|SELL> <SYMBOL> <PRICE> <QUANTITY>" << std::endl;
                 continue;
             }
@@ -219,7 +1685,7 @@ void TradingEngine::start() {
         }
         else if (command == "show_orders") {
             std::string symbol;
-            if (!(iss >> symbol)) {
+            if (!parser.read(symbol)) {
                 std::cout << "Invalid command format. Use: show_orders <SYMBOL>" << std::endl;
                 continue;
             }
@@ -8,57 +8,576 @@
 #include <algorithm>
 #include <mutex>
 #include <map>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <functional>
+#include "metrics.h"
+#include "book_side.h"
 
 enum class OrderSide {
     BUY,
     SELL
 };
 
+// STOP and STOP_LIMIT orders wait off-book until the last trade reaches
+// stop_price, then become MARKET and LIMIT orders respectively. A MARKET
+// order trades at resting prices and its unfilled remainder is cancelled.
+enum class OrderType {
+    LIMIT,
+    MARKET,
+    STOP,
+    STOP_LIMIT,
+    FILL_OR_KILL   // Limit order that trades in full on arrival or not at all
+};
+
+// Self-trade prevention: what happens when an order would match another
+// order of the same owner. The incoming (newer) order's mode decides.
+enum class StpMode {
+    NONE,
+    CANCEL_NEWEST,
+    CANCEL_OLDEST,
+    CANCEL_BOTH,
+    DECREMENT      // Shrink both by the overlap without trading
+};
+
+// While an order rests in a book, its quantities are kept in the level's
+// OrderSlot and copied back here when it leaves.
 struct Order {
     std::string symbol;           
     OrderSide side;              
     double price;             
-    int quantity;           
+    int quantity;                 // For icebergs, the displayed slice only
     int order_id;                
     long long timestamp;     
+    int session_id;               // Owning connection, 0 for local orders
+    int owner_id;                 // Owning account, 0 is anonymous and exempt from STP
+    StpMode stp_mode;
+    OrderType type;
+    double stop_price;            // Trigger for STOP/STOP_LIMIT, 0 otherwise
+    int display_quantity;         // Iceberg slice size, 0 displays the whole order
+    int hidden_quantity;          // Iceberg reserve behind the displayed slice
+    
+    Order(const std::string& sym, OrderSide s, double p, int q, int id, int session = 0, int owner = 0,
+          StpMode stp = StpMode::NONE);
+    
+    int totalQuantity() const { return quantity + hidden_quantity; }
+};
+
+// One entry of a BATCH request. REPLACE keeps the order's side and ID but
+// re-queues it at the new price/quantity with fresh time priority.
+struct BatchEntry {
+    enum class Type {
+        ADD,
+        REPLACE
+    };
+    
+    Type type;
+    std::string symbol;
+    OrderSide side;
+    double price;
+    int quantity;
+    int order_id;
+};
+
+// One side of a trade, reported to the session that owns the order
+struct Fill {
+    std::string symbol;
+    int order_id;
+    int session_id;
+    int owner_id;
+    OrderSide side;
+    double price;
+    int quantity;
+    int remaining;
+};
+
+// Quantity taken off a resting order other than by trading: a cancel by its
+// owner, or self-trade prevention. remaining is 0 once the order is gone.
+struct OrderCancel {
+    std::string symbol;
+    int order_id;
+    int session_id;
+    int owner_id;
+    OrderSide side;
+    double price;
+    int quantity;
+    int remaining;
+};
+
+// Top of book; a quantity of 0 means that side is empty
+struct Quote {
+    std::string symbol;
+    double bid_price = 0.0;
+    int64_t bid_quantity = 0;
+    double ask_price = 0.0;
+    int64_t ask_quantity = 0;
+    std::string spread;  // Set for an implied quote: the spread it is derived through
+    
+    bool operator==(const Quote& other) const {
+        return bid_price == other.bid_price && bid_quantity == other.bid_quantity &&
+               ask_price == other.ask_price && ask_quantity == other.ask_quantity;
+    }
+};
+
+// A book's top of book for readers that must not take book_mutex. One
+// writer, the book under book_mutex, publishes; readers retry while the
+// sequence is odd or moved during their read (a seqlock).
+class QuoteSnapshot {
+public:
+    void publish(const Quote& quote) {
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bid_price.store(quote.bid_price, std::memory_order_relaxed);
+        bid_quantity.store(quote.bid_quantity, std::memory_order_relaxed);
+        ask_price.store(quote.ask_price, std::memory_order_relaxed);
+        ask_quantity.store(quote.ask_quantity, std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+    
+    // Fills in the prices and quantities of quote, not its symbol
+    void read(Quote& quote) const {
+        uint64_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            quote.bid_price = bid_price.load(std::memory_order_relaxed);
+            quote.bid_quantity = bid_quantity.load(std::memory_order_relaxed);
+            quote.ask_price = ask_price.load(std::memory_order_relaxed);
+            quote.ask_quantity = ask_quantity.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1) != 0);
+    }
     
-    Order(const std::string& sym, OrderSide s, double p, int q, int id);
+private:
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<double> bid_price{0.0};
+    std::atomic<int64_t> bid_quantity{0};
+    std::atomic<double> ask_price{0.0};
+    std::atomic<int64_t> ask_quantity{0};
+};
+
+// Callbacks for fills, cancels and top-of-book changes. Books invoke them after
+// releasing book_mutex, so handlers may block or call back into the engine.
+struct MarketEventHandlers {
+    std::function<void(const Fill&)> on_fill;
+    std::function<void(const OrderCancel&)> on_cancel;
+    std::function<void(const Quote&)> on_quote;
+};
+
+// Level backend of a symbol's book; see book_side.h
+enum class BookType {
+    TREE,       // Tree keyed by price, any price allowed
+    TICK_TREE,  // Tree keyed by integer ticks, prices on a tick grid
+    LADDER      // Dense tick ladder with a bitmap of non-empty levels
+};
+
+// A state-changing engine call as recorded for replication. Applying the
+// same commands in sequence order to a fresh engine reproduces its books,
+// order IDs and order timestamps; see replication.h.
+struct EngineCommand {
+    enum class Type : uint8_t {
+        ADD_ORDER,
+        FILL_OR_KILL,
+        ICEBERG,
+        STOP,
+        BATCH,
+        CANCEL,
+        CANCEL_ALL,
+        BOOK_TYPE,
+        SPREAD,
+        AUCTION_START,
+        AUCTION_UNCROSS,
+        ACCOUNT  // A risk account was created; changes no book
+    };
+    
+    Type type = Type::ADD_ORDER;
+    uint64_t sequence = 0;
+    int64_t time = 0;         // Timestamp of orders stamped by the call, microseconds since the epoch
+    int next_order_id = 0;    // Before the call; a replica checks its own matches
+    std::string symbol;       // The spread itself for SPREAD, the account name for ACCOUNT; empty
+                              // for CANCEL_ALL on every book
+    std::string buy_leg;      // SPREAD legs
+    std::string sell_leg;
+    OrderSide side = OrderSide::BUY;
+    bool any_side = true;     // CANCEL_ALL without a side
+    double price = 0.0;       // STOP: limit price, 0 for stop-market
+    double stop_price = 0.0;
+    double tick_size = 0.0;
+    BookType book_type = BookType::TREE;
+    int quantity = 0;
+    int display_quantity = 0;
+    int order_id = 0;         // CANCEL
+    int session_id = 0;
+    int owner_id = 0;         // The account's ID for ACCOUNT
+    StpMode stp_mode = StpMode::NONE;
+    std::vector<BatchEntry> batch;
+};
+
+// Events from one book operation, gathered under book_mutex and published
+// once it is released
+struct BookEvents {
+    std::vector<Fill> fills;
+    std::vector<OrderCancel> cancels;
+    std::optional<Quote> quote;
+};
+
+// Passes events to handlers. Inside a journaled engine call they are held
+// until the call has released its locks.
+void publishBookEvents(const MarketEventHandlers& handlers, const BookEvents& events);
+
+// Front order of one side of a book
+struct BestOrder {
+    double price;
+    int quantity;
 };
 
+// A symbol's order book as the engine sees it: one virtual call per
+// operation. The matching code is in BasicOrderBook, compiled once per
+// backend so its loops call the level container directly.
 class OrderBook {
+public:
+    virtual ~OrderBook() = default;
+    
+    virtual std::string addOrder(std::shared_ptr<Order> order) = 0;
+    
+    // Applies the given entries in order under a single book_mutex acquisition
+    virtual void applyBatch(const std::vector<BatchEntry>& entries, const std::vector<size_t>& indices,
+                            int session_id, int owner_id, StpMode stp_mode, std::vector<std::string>& results) = 0;
+    
+    virtual std::string cancelOrder(int order_id, int session_id) = 0;
+    
+    virtual std::string startAuction() = 0;
+    // Executes everything that crosses at the equilibrium price and returns
+    // the book to continuous matching
+    virtual std::string uncrossAuction() = 0;
+    
+    // Cancels every resting order of the session, optionally on one side only.
+    // Walks the session's own index, so cost is proportional to its orders.
+    virtual int cancelSessionOrders(int session_id, std::optional<OrderSide> side) = 0;
+    
+    // Adds the book's resting orders and untriggered stops to by_owner
+    virtual void countOpenOrders(std::unordered_map<int, int>& by_owner) const = 0;
+    
+    // Rendered depth for SHOW_ORDERS; repeat calls with no book change in
+    // between return the same shared text without rendering again
+    virtual std::shared_ptr<const std::string> displayOrders() const = 0;
+    
+    virtual Quote getQuote() const = 0;
+    // Top of book as of the last completed operation, without locking
+    virtual void readQuote(Quote& quote) const = 0;
+    
+    virtual const SymbolMetrics& getMetrics() const = 0;
+    
+    // Implied matching, which trades a spread's book against its legs' books
+    // (see spread.h). The caller locks the books together with bookMutex and
+    // calls bestOrder, fillBest and finishImplied while holding every lock,
+    // then publishImplied for each book once they are all released.
+    virtual std::mutex& bookMutex() const = 0;
+    // Nothing while the book is in auction
+    virtual std::optional<BestOrder> bestOrder(OrderSide side) const = 0;
+    // Trades quantity, at most the front order's, off the front order of side
+    virtual void fillBest(OrderSide side, double price, int quantity) = 0;
+    virtual void finishImplied(BookEvents& events) = 0;
+    virtual void publishImplied(const BookEvents& events) const = 0;
+};
+
+// Builds a book on the given backend; tick_size is required for the tick
+// backends and ignored by TREE
+std::unique_ptr<OrderBook> makeOrderBook(const std::string& symbol, const MarketEventHandlers* handlers,
+                                         BookType type, double tick_size);
+
+template <typename Backend>
+class BasicOrderBook : public OrderBook {
 private:
+    // Where a resting order lives, so it can be removed without searching.
+    // The book owns resting orders through here; slots point at them.
+    struct OrderLocation {
+        OrderSide side;
+        double price;
+        uint64_t position;  // Slot position in the price level
+        std::shared_ptr<Order> order;
+    };
+    
     std::string symbol;
-    std::vector<std::shared_ptr<Order>> buy_orders;   // All buy orders
-    std::vector<std::shared_ptr<Order>> sell_orders;  // All sell orders
+    typename Backend::template Levels<std::greater<>> bids;  // Best (highest) first
+    typename Backend::template Levels<std::less<>> asks;     // Best (lowest) first
+    
+    std::unordered_map<int, OrderLocation> order_index;
+    
+    // Untriggered stops, keyed by stop price in trigger order. A trade at P
+    // fires the buy stops <= P and sell stops >= P, always a prefix.
+    std::multimap<double, std::shared_ptr<Order>, std::less<double>> buy_stops;
+    std::multimap<double, std::shared_ptr<Order>, std::greater<double>> sell_stops;
+    std::unordered_map<int, std::shared_ptr<Order>> stop_index;
+    double last_trade_price;
+    bool in_auction;  // Orders accumulate without matching until uncrossAuction
+    std::unordered_map<int, std::unordered_set<int>> session_orders;  // session -> resting order IDs
     
     mutable std::mutex book_mutex;  // Thread-safe access to this order book
+    mutable SymbolMetrics metrics;
+    
+    // Events gathered under book_mutex and published once it is released
+    const MarketEventHandlers* handlers;
+    std::vector<Fill> pending_fills;
+    std::vector<OrderCancel> pending_cancels;
+    Quote last_quote;
+    QuoteSnapshot published_quote;  // last_quote, for readQuote
+    int64_t bid_quantity;
+    int64_t ask_quantity;
+    int64_t bid_order_count;
+    int64_t ask_order_count;
     
-    std::string matchOrders();
+    // Bumped by every operation that changes what displayOrders shows; the
+    // last rendering is kept with the version it was taken at
+    uint64_t version;
+    mutable std::shared_ptr<const std::string> snapshot;
+    mutable uint64_t snapshot_version;
     
-    void sortOrders();
+    // Matches while the book is crossed; aggressor is the order that crossed
+    // it. With an auction price every trade prints at that price and only
+    // orders that accept it take part.
+    std::string matchOrders(const Order* aggressor, double auction_price = 0.0);
+    
+    // Price that maximizes executable volume, with ties going to the smallest
+    // imbalance and then to the price nearest the last trade; nullopt if the
+    // book is not crossed. One pass over the crossed levels of each side.
+    std::optional<double> equilibriumPrice() const;
+    
+    // Fires stops until none remain triggered; activated orders may trade and
+    // move the price again, so cascades are worked off in a loop, not recursion
+    std::string triggerStops();
+    
+    // Resolves a cross between the front orders of the best levels when both
+    // belong to one owner; returns the response text
+    std::string preventSelfTrade(OrderSlot& buy, OrderSlot& sell, bool buy_is_newer);
+    
+    void updateDepthMetrics();
+    
+    Quote currentQuote() const;
+    
+    void collectEvents(BookEvents& events);  // Caller holds book_mutex
+    void publishEvents(const BookEvents& events) const;
+    void recordCancel(const Order& order, int quantity);  // Before quantity is taken off the order
+    void recordCancel(const Order& order, int quantity, int remaining);
+    
+    // Callers must hold book_mutex
+    std::string insertOrder(std::shared_ptr<Order> order);
+    std::string insertStop(std::shared_ptr<Order> order);
+    bool replenishOrder(int order_id);
+    PriceLevel& levelOf(const OrderLocation& location);
+    void reindexLevel(const PriceLevel& level);  // After PriceLevel::remove repacks it
+    const Order* findOrder(int order_id) const;
+    bool acceptsPrice(OrderSide side, double price) const;
+    bool sweepLimit(OrderSide side, double& limit) const;  // Price a market order on side sweeps to
+    std::string rejectOrder(const Order& order, const std::string& reason);
+    
+    // Calls f with the bid or the ask levels; f is compiled for each side
+    template <typename F>
+    decltype(auto) onSide(OrderSide side, F&& f) { return side == OrderSide::BUY ? f(bids) : f(asks); }
+    template <typename F>
+    decltype(auto) onSide(OrderSide side, F&& f) const { return side == OrderSide::BUY ? f(bids) : f(asks); }
+    std::string replaceOrder(int order_id, double price, int quantity, int session_id, int owner_id,
+                             StpMode stp_mode);
+    std::shared_ptr<Order> removeOrder(int order_id);
+    void forgetSessionOrder(int session_id, int order_id);
     
 public:
-    OrderBook(const std::string& sym) : symbol(sym) {}
+    // tick_size is passed to the level containers; see book_side.h
+    BasicOrderBook(const std::string& sym, const MarketEventHandlers* h, double tick_size)
+        : symbol(sym), bids(tick_size), asks(tick_size), last_trade_price(0.0), in_auction(false), handlers(h), bid_quantity(0), ask_quantity(0),
+          bid_order_count(0), ask_order_count(0), version(0), snapshot_version(0) {
+        last_quote.symbol = sym;
+    }
     
-    std::string addOrder(std::shared_ptr<Order> order);
+    std::string addOrder(std::shared_ptr<Order> order) override;
+    void applyBatch(const std::vector<BatchEntry>& entries, const std::vector<size_t>& indices,
+                    int session_id, int owner_id, StpMode stp_mode, std::vector<std::string>& results) override;
+    std::string cancelOrder(int order_id, int session_id) override;
+    std::string startAuction() override;
+    std::string uncrossAuction() override;
+    int cancelSessionOrders(int session_id, std::optional<OrderSide> side) override;
+    void countOpenOrders(std::unordered_map<int, int>& by_owner) const override;
+    std::shared_ptr<const std::string> displayOrders() const override;
+    Quote getQuote() const override;
+    void readQuote(Quote& quote) const override { published_quote.read(quote); }
+    const SymbolMetrics& getMetrics() const override { return metrics; }
     
-    std::string displayOrders() const;
+    std::mutex& bookMutex() const override { return book_mutex; }
+    std::optional<BestOrder> bestOrder(OrderSide side) const override;
+    void fillBest(OrderSide side, double price, int quantity) override;
+    void finishImplied(BookEvents& events) override;
+    void publishImplied(const BookEvents& events) const override { publishEvents(events); }
 };
 
+class Spread;
+
 class TradingEngine {
 private:
-    std::map<std::string, OrderBook> order_books;
-    int next_order_id;
+    std::map<std::string, std::unique_ptr<OrderBook>> order_books;
+    std::atomic<int> next_order_id;
     std::mutex engine_mutex;  // Protects order_books vector
     
+    // Every book, newest first, for readers that do not take engine_mutex.
+    // Nodes are added under engine_mutex and live as long as the engine.
+    struct ListedBook {
+        std::string symbol;
+        const OrderBook* book;
+        const ListedBook* next;
+    };
+    std::atomic<const ListedBook*> listed_books;
+    std::vector<std::unique_ptr<ListedBook>> listed_book_nodes;
+    LockStats engine_lock_stats;
+    MarketEventHandlers handlers;
+    std::unordered_map<std::string, std::pair<BookType, double>> book_types;  // Symbols not on TREE, with tick size
+    int book_node;  // NUMA node new books are allocated on, -1 for the creating thread's
+    
+    // Spreads by symbol, and the spreads each symbol is the book or a leg of;
+    // guarded by engine_mutex. has_spreads spares the lookup until there are any.
+    std::map<std::string, std::unique_ptr<Spread>> spreads;
+    std::unordered_map<std::string, std::vector<Spread*>> spreads_by_symbol;
+    std::atomic<bool> has_spreads;
+    
+    // Replication: journal sees each state-changing call before it is
+    // applied. A journaled call first locks every symbol it may change,
+    // spreads included, in name order, and holds them until it ends; it
+    // takes sequence_mutex only to number itself, take its order IDs and
+    // append to the journal. Calls that share a book are therefore applied
+    // in journal order, and calls on unrelated books run at once.
+    std::function<void(const EngineCommand&)> journal;
+    std::mutex ordering_mutex;  // Guards symbol_locks; held while a call picks its locks
+    std::map<std::string, std::mutex> symbol_locks;
+    std::atomic<uint64_t> spread_generation;  // Bumped when a spread links books
+    std::mutex sequence_mutex;
+    uint64_t last_sequence;
+    
+    // Held by a state-changing call. A journaled or replayed call's orders
+    // are stamped with its recorded time, and a journaled call holds its
+    // symbol locks and events until it ends.
+    struct Sequenced {
+        explicit Sequenced(int first_id) : first_order_id(first_id) {}
+        Sequenced(int first_id, int64_t time, std::vector<std::unique_lock<std::mutex>> held);
+        Sequenced(const Sequenced&) = delete;
+        Sequenced& operator=(const Sequenced&) = delete;
+        ~Sequenced();
+        
+        int first_order_id;  // IDs taken for the call's new orders start here
+        std::vector<std::unique_lock<std::mutex>> locks;
+        bool timed = false;
+        bool holding_events = false;
+    };
+    // order_ids is how many new orders the call will number
+    template <typename Describe>
+    Sequenced sequence(EngineCommand::Type type, int order_ids, Describe&& describe);
+    std::vector<std::unique_lock<std::mutex>> lockSymbols(const EngineCommand& command);
+    
     OrderBook* findOrderBook(const std::string& symbol);
+    OrderBook* getOrCreateOrderBook(const std::string& symbol);  // Caller holds engine_mutex
+    std::string submitOrder(std::shared_ptr<Order> order);
+    
+    // After an operation on symbol's book: updates the spreads on it, then
+    // those on any leg their implied trades moved
+    void updateSpreads(const std::string& symbol);
     
 public:
-    TradingEngine() : next_order_id(1) {}
+    TradingEngine();
+    ~TradingEngine();
+    
+    // assigned_id, if given, receives the new order's ID, including for
+    // orders that are rejected or killed
+    std::string addOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                         int session_id = 0, int owner_id = 0, StpMode stp_mode = StpMode::NONE,
+                         int* assigned_id = nullptr);
+    
+    std::string addBatch(std::vector<BatchEntry> entries, int session_id = 0, int owner_id = 0,
+                         StpMode stp_mode = StpMode::NONE);
+    
+    // Trades the whole quantity at price or better on arrival, or is cancelled
+    std::string addFillOrKillOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                                   int session_id = 0, int owner_id = 0, StpMode stp_mode = StpMode::NONE,
+                                   int* assigned_id = nullptr);
+    
+    // Rests quantity but only ever shows display_quantity of it in the book
+    std::string addIcebergOrder(const std::string& symbol, OrderSide side, double price, int quantity,
+                                int display_quantity, int session_id = 0, int owner_id = 0,
+                                StpMode stp_mode = StpMode::NONE);
+    
+    // A limit_price of 0 places a stop-market order, otherwise a stop-limit
+    std::string addStopOrder(const std::string& symbol, OrderSide side, double stop_price, double limit_price,
+                             int quantity, int session_id = 0, int owner_id = 0,
+                             StpMode stp_mode = StpMode::NONE);
+    
+    std::string cancelOrder(const std::string& symbol, int order_id, int session_id);
+    
+    // Picks the symbol's book backend. The tick backends need a tick_size
+    // above 0 and then only take prices that are multiples of it. Only
+    // possible before the symbol's book exists.
+    bool setBookType(const std::string& symbol, BookType type, double tick_size = 0.0);
+    
+    // Allocates books created from now on on this NUMA node rather than on
+    // whichever client thread first names the symbol. Containers that grow
+    // later allocate on the matching thread, so pin those to the same node.
+    void setBookNode(int node);
     
-    std::string addOrder(const std::string& symbol, OrderSide side, double price, int quantity);
+    // Defines symbol as a spread that buys buy_leg and sells sell_leg, with
+    // a book of its own; see spread.h. symbol must not have a book yet and
+    // the legs must be outrights.
+    std::string defineSpread(const std::string& symbol, const std::string& buy_leg, const std::string& sell_leg);
+    bool isSpread(const std::string& symbol);
+    
+    // Call auction for a symbol, e.g. around the open and close
+    std::string startAuction(const std::string& symbol);
+    std::string uncrossAuction(const std::string& symbol);
+    
+    // Mass cancel for a session; an empty symbol means every book
+    int cancelAll(int session_id, const std::string& symbol = "",
+                  std::optional<OrderSide> side = std::nullopt);
+    
+    // Journals that a risk account was created with this ID, so a replica
+    // can number its accounts the same way; the engine keeps no accounts
+    void recordAccount(int account_id, const std::string& name);
+    
+    // Resting orders and untriggered stops across all books, by owner
+    std::unordered_map<int, int> openOrdersByOwner();
     
     std::string showOrders(const std::string& symbol);
+    // Shared rendering of the book as showOrders text, or null for an
+    // unknown symbol; the network server sends it without copying
+    std::shared_ptr<const std::string> orderSnapshot(const std::string& symbol);
+    
+    // Top of book for a symbol; nullopt if the symbol has never traded
+    std::optional<Quote> getQuote(const std::string& symbol);
+    
+    // Top of book for each of symbols, or for every book by symbol if it is
+    // empty, read from each book's published quote without taking
+    // engine_mutex or any book_mutex. Unknown symbols get an empty quote.
+    std::vector<Quote> getQuotes(const std::vector<std::string>& symbols) const;
+    
+    // Install before any orders arrive; handlers are not synchronized
+    void setFillHandler(std::function<void(const Fill&)> handler) { handlers.on_fill = std::move(handler); }
+    void setCancelHandler(std::function<void(const OrderCancel&)> handler) { handlers.on_cancel = std::move(handler); }
+    void setQuoteHandler(std::function<void(const Quote&)> handler) { handlers.on_quote = std::move(handler); }
+    
+    // Snapshot of per-symbol metrics for the exporter
+    void collectMetrics(std::vector<std::pair<std::string, const SymbolMetrics*>>& out);
+    const LockStats& engineLockStats() const { return engine_lock_stats; }
+    
+    // Passes every state-changing call to journal, in the order they are
+    // applied, from then on. This serializes calls that share a book, and
+    // holds each call's events until it ends. Install before any orders
+    // arrive.
+    void setJournal(std::function<void(const EngineCommand&)> handler) { journal = std::move(handler); }
+    
+    // Applies a command journaled by another engine, on one thread in
+    // sequence order. False without applying it if this engine has
+    // diverged from the journaling one. response, if given, receives the
+    // call's response text.
+    bool replay(const EngineCommand& command, std::string* response = nullptr);
+    
+    // ID the next order will get; a command to replay carries it
+    int nextOrderId() const { return next_order_id.load(std::memory_order_relaxed); }
     
     void start();
 };